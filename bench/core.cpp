@@ -0,0 +1,162 @@
+// Microbenchmarks of core paths: epoller loop dispatch, linear buffer, write_stream and timers.
+
+#include <epoller/epoller.h>
+#include <epoller/fdepoller.h>
+#include <epoller/timepoller.h>
+#include <linbuff/linbuff.h>
+#include <benchmark/benchmark.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <vector>
+
+/// @brief Records build of the benchmark into context of results (JSON output included).
+static struct bench_context
+{
+	bench_context()
+	{
+		benchmark::AddCustomContext("epoller_build_type", EPOLLER_BENCH_BUILD_TYPE);
+		benchmark::AddCustomContext("epoller_opt_flags", EPOLLER_BENCH_OPT_FLAGS);
+	}
+} context;
+
+/// @brief Always ready event, its eventfd is never read.
+struct ready_event : epoller_event
+{
+	int            fd;
+	unsigned long *cnt;
+	unsigned long  last;
+
+	ready_event(unsigned long *cnt, unsigned long last) : fd(eventfd(1, 0)), cnt(cnt), last(last) {}
+	virtual ~ready_event() {close(fd);}
+
+	virtual int handler(struct epoller *epoller, struct epoll_event *revent)
+	{
+		revent->events = 0;
+		return ++*cnt % last ? 0 : 1;
+	}
+};
+
+// One loop iteration (epoll_wait plus dispatch) with N ready events.
+static void BM_loop_dispatch(benchmark::State &state)
+{
+	size_t n = state.range(0);
+	struct epoller ep(n);
+	std::vector<ready_event*> evs(n);
+	unsigned long cnt = 0;
+	struct epoll_event event;
+
+	ep.init();
+	for (auto &ev : evs) {
+		ev = new ready_event(&cnt, n);
+		event.events   = EPOLLIN;
+		event.data.ptr = ev;
+		epoll_ctl(ep.fd, EPOLL_CTL_ADD, ev->fd, &event);
+	}
+
+	for (auto _ : state)
+		ep.loop();
+
+	for (auto ev : evs)
+		delete ev;
+
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_loop_dispatch)->RangeMultiplier(4)->Range(1, 1024);
+
+static void BM_linbuff_write_read(benchmark::State &state)
+{
+	struct linbuff lb;
+	std::vector<uint8_t> data(state.range(0)), out(state.range(0));
+
+	linbuff_alloc(&lb, 65536);
+	for (auto _ : state) {
+		linbuff_write(&lb, data.data(), data.size());
+		linbuff_read(&lb, out.data(), out.size());
+		linbuff_clear(&lb);
+		benchmark::ClobberMemory();
+	}
+	linbuff_free(&lb);
+
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_linbuff_write_read)->Arg(16)->Arg(256)->Arg(4096);
+
+// Compaction of half-consumed buffer holding given number of bytes.
+static void BM_linbuff_compact(benchmark::State &state)
+{
+	struct linbuff lb;
+	std::vector<uint8_t> data(2 * state.range(0));
+
+	linbuff_alloc(&lb, data.size());
+	for (auto _ : state) {
+		linbuff_write(&lb, data.data(), data.size());
+		linbuff_skip(&lb, state.range(0));
+		linbuff_compact(&lb);
+		linbuff_clear(&lb);
+	}
+	linbuff_free(&lb);
+
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_linbuff_compact)->Arg(16)->Arg(256)->Arg(4096);
+
+// Direct write_stream to /dev/null (one syscall per call).
+static void BM_write_stream(benchmark::State &state)
+{
+	struct epoller ep;
+	fdepoller ev(&ep);
+	std::vector<uint8_t> data(state.range(0));
+
+	ep.init();
+	ev.init(open("/dev/null", O_WRONLY), 0, 65536, false, false, false);
+	for (auto _ : state)
+		ev.write_stream(data.data(), data.size());
+
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_write_stream)->Arg(16)->Arg(256)->Arg(4096);
+
+// Corked write_stream to /dev/null, flushed after every 16 calls.
+static void BM_write_stream_corked(benchmark::State &state)
+{
+	struct epoller ep;
+	fdepoller ev(&ep);
+	std::vector<uint8_t> data(state.range(0));
+
+	ep.init();
+	ev.init(open("/dev/null", O_WRONLY), 0, 65536, false, false, false);
+	ev.tx_cork       = true;
+	ev.tx_cork_bytes = 16 * data.size();
+	for (auto _ : state)
+		ev.write_stream(data.data(), data.size());
+	ev.tx_uncork();
+	ep.flushes.clear();
+	ev.tx_corked = false;
+
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_write_stream_corked)->Arg(16)->Arg(256)->Arg(4096);
+
+static int timer_fired(timepoller &sender, uint64_t exp)
+{
+	return 1;
+}
+
+// Arming one-shot timer and waiting for it within the loop.
+static void BM_timer_arm_fire(benchmark::State &state)
+{
+	struct epoller ep;
+	timepoller tp(&ep);
+
+	ep.init();
+	tp.init();
+	tp._timerhandler = timer_fired;
+	for (auto _ : state) {
+		tp.arm_oneshot_usec(1);
+		ep.loop();
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_timer_arm_fire);
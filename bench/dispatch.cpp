@@ -0,0 +1,134 @@
+// Per-event dispatch cost of runtime-polymorphic and compile-time dispatched epollers.
+// The reading syscall is replaced by a fake one, so only the dispatch path from epoller_event::handler
+// to the receiver is measured.
+
+#include <epoller/fdepoller.h>
+#include <epoller/basic_fdepoller.h>
+#include <benchmark/benchmark.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define BENCH_RXSIZE 64
+
+/// @brief Runtime-polymorphic epoller with fake reading.
+struct fake_fdepoller : fdepoller
+{
+	fake_fdepoller(struct epoller *epoller) : fdepoller(epoller) {}
+
+	virtual int epoll_in()
+	{
+		linbuff_forward(&rxbuff, linbuff_towr(&rxbuff));
+		return rx(BENCH_RXSIZE);
+	}
+};
+
+/// @brief Virtual receiver.
+struct virtual_receiver : fdepoller::receiver
+{
+	unsigned long bytes;
+
+	virtual_receiver() : bytes(0) {}
+
+	virtual int rx(fdepoller &sender, int len)
+	{
+		bytes += len;
+		linbuff_clear(&sender.rxbuff);
+		return 0;
+	}
+};
+
+struct static_fdepoller;
+
+/// @brief Compile-time bound receiver.
+struct static_receiver : basic_fdepoller_receiver<static_fdepoller>
+{
+	unsigned long bytes;
+
+	static_receiver() : bytes(0) {}
+
+	int rx(static_fdepoller &sender, int len);
+};
+
+/// @brief Compile-time dispatched epoller with fake reading.
+struct static_fdepoller : basic_fdepoller<static_fdepoller, static_receiver>
+{
+	static_fdepoller(struct epoller *epoller, static_receiver *target) : basic_fdepoller(epoller, target) {}
+
+	ssize_t do_read()
+	{
+		size_t len = linbuff_towr(&rxbuff);
+		linbuff_forward(&rxbuff, len);
+		return len;
+	}
+};
+
+inline int static_receiver::rx(static_fdepoller &sender, int len)
+{
+	bytes += len;
+	linbuff_clear(&sender.rxbuff);
+	return 0;
+}
+
+static unsigned long callback_bytes;
+
+static int callback_rx(fdepoller &sender, int len)
+{
+	callback_bytes += len;
+	linbuff_clear(&sender.rxbuff);
+	return 0;
+}
+
+/// @brief Calls handler of initialized epoller as epoller::loop does.
+template <typename T>
+static void run(benchmark::State &state, struct epoller *ep, T &ev)
+{
+	struct epoll_event revent;
+	struct epoller_event *self = &ev;
+
+	ev.pthis = &self;
+	for (auto _ : state) {
+		revent.events   = EPOLLIN;
+		revent.data.ptr = &ev;
+		benchmark::DoNotOptimize(ev.handler(ep, &revent));
+	}
+	ev.pthis = 0;
+
+	state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_dispatch_callback(benchmark::State &state)
+{
+	struct epoller ep;
+	fake_fdepoller ev(&ep);
+
+	ep.init();
+	ev.init(eventfd(0, EFD_NONBLOCK), BENCH_RXSIZE, 0);
+	ev._rx = callback_rx;
+	run(state, &ep, ev);
+}
+BENCHMARK(BM_dispatch_callback);
+
+static void BM_dispatch_virtual(benchmark::State &state)
+{
+	struct epoller ep;
+	fake_fdepoller ev(&ep);
+	virtual_receiver rcvr;
+
+	ep.init();
+	ev.init(eventfd(0, EFD_NONBLOCK), BENCH_RXSIZE, 0);
+	ev.rcvr = &rcvr;
+	run(state, &ep, ev);
+}
+BENCHMARK(BM_dispatch_virtual);
+
+static void BM_dispatch_static(benchmark::State &state)
+{
+	struct epoller ep;
+	static_receiver rcvr;
+	static_fdepoller ev(&ep, &rcvr);
+
+	ep.init();
+	ev.init(eventfd(0, EFD_NONBLOCK), BENCH_RXSIZE, 0);
+	run(state, &ep, ev);
+}
+BENCHMARK(BM_dispatch_static);
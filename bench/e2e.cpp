@@ -0,0 +1,192 @@
+// End-to-end scenarios: TCP echo over loopback, eventfd ping-pong between two loops and signalfd throughput.
+
+#include <epoller/evepoller.h>
+#include <epoller/sigepoller.h>
+#include <epoller/sockepoller.h>
+#include <epoller/tcpcepoller.h>
+#include <epoller/tcpsepoller.h>
+#include <benchmark/benchmark.h>
+#include <arpa/inet.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+#define BENCH_SIGNAL_BATCH 64
+
+/// @brief TCP echo server and client within one loop.
+struct echo : tcpsepoller::receiver, tcpcepoller::receiver
+{
+	struct epoller  ep;
+	tcpsepoller     server;
+	sockepoller     peer;
+	tcpcepoller     client;
+	size_t          msglen;
+	size_t          received;
+
+	echo(size_t msglen) : ep(), server(&ep), peer(&ep), client(&ep), msglen(msglen), received(0) {}
+
+	bool init()
+	{
+		struct sockaddr_in addr;
+		socklen_t addrlen = sizeof addr;
+
+		if (!ep.init() || !server.socket(AF_INET, "127.0.0.1", 0, 16))
+			return false;
+		getsockname(server.fd, (struct sockaddr *) &addr, &addrlen);
+
+		server.rcvr = this;
+		client.rcvr = this;
+		if (!client.socket(AF_INET, 65536, 65536) || !client.connect("127.0.0.1", ntohs(addr.sin_port)))
+			return false;
+
+		// run until connected and accepted
+		return ep.loop() && ep.loop();
+	}
+
+	virtual int acc(tcpsepoller &sender, int fd, const struct sockaddr *addr, const socklen_t *addrlen)
+	{
+		if (!peer.init(fd, 65536, 65536))
+			return -1;
+		peer.rcvr = this;
+		return 1;
+	}
+
+	virtual int con(tcpcepoller &sender, bool connected)
+	{
+		return connected ? 1 : -1;
+	}
+
+	virtual int rx(fdepoller &sender, int len)
+	{
+		if (len <= 0)
+			return -1;
+
+		if (&sender == &peer) {
+			sender.write_stream(LINBUFF_RD_PTR(&sender.rxbuff), len);
+			linbuff_clear(&sender.rxbuff);
+			return 0;
+		}
+
+		linbuff_clear(&sender.rxbuff);
+		received += len;
+		return received >= msglen ? 1 : 0;
+	}
+
+	virtual int tx(fdepoller &sender, int len)
+	{
+		return len < 0 ? -1 : 0;
+	}
+};
+
+static void BM_tcp_echo(benchmark::State &state)
+{
+	echo e(state.range(0));
+	std::vector<uint8_t> msg(state.range(0));
+
+	if (!e.init()) {
+		state.SkipWithError("connecting failed");
+		return;
+	}
+
+	for (auto _ : state) {
+		e.received = 0;
+		e.client.write_stream(msg.data(), msg.size());
+		e.ep.loop();
+	}
+
+	state.SetItemsProcessed(state.iterations());
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_tcp_echo)->Arg(64)->Arg(4096);
+
+/// @brief One side of eventfd ping-pong, it runs its own loop.
+struct pingpong : evepoller::receiver
+{
+	struct epoller  ep;
+	evepoller       ev;
+	pingpong       *other;
+	bool            bounce;
+
+	pingpong(bool bounce) : ep(), ev(&ep), other(0), bounce(bounce) {}
+
+	bool init()
+	{
+		if (!ep.init() || !ev.init())
+			return false;
+		ev.rcvr = this;
+		return true;
+	}
+
+	virtual int recv_handler(evepoller &sender, uint64_t cnt)
+	{
+		if (!bounce)
+			return 1; // pong received
+
+		if (cnt > 1)
+			return 1; // stop request
+		other->ev.send();
+		return 0;
+	}
+};
+
+static void BM_eventfd_pingpong(benchmark::State &state)
+{
+	pingpong a(false), b(true);
+
+	if (!a.init() || !b.init()) {
+		state.SkipWithError("initialization failed");
+		return;
+	}
+	a.other = &b;
+	b.other = &a;
+
+	std::thread t([&b] {b.ep.loop();});
+	for (auto _ : state) {
+		b.ev.send();
+		a.ep.loop();
+	}
+	b.ev.send(2);
+	t.join();
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_eventfd_pingpong)->UseRealTime();
+
+static unsigned long signals_received;
+
+static int signal_received(sigepoller &sender, struct signalfd_siginfo *siginfo)
+{
+	return ++signals_received % BENCH_SIGNAL_BATCH ? 0 : 1;
+}
+
+// Batches of queued realtime signals delivered through signalfd.
+static void BM_signalfd_throughput(benchmark::State &state)
+{
+	struct epoller ep;
+	sigepoller sp(&ep);
+	sigset_t sigset, oldset;
+	union sigval val;
+
+	sigemptyset(&sigset);
+	sigaddset(&sigset, SIGRTMIN);
+	pthread_sigmask(SIG_BLOCK, &sigset, &oldset);
+
+	ep.init();
+	sp.init(&sigset);
+	sp._sighandler = signal_received;
+	val.sival_int = 0;
+
+	for (auto _ : state) {
+		for (int i = 0; i < BENCH_SIGNAL_BATCH; ++i)
+			pthread_sigqueue(pthread_self(), SIGRTMIN, val);
+		ep.loop();
+	}
+
+	sp.cleanup();
+	pthread_sigmask(SIG_SETMASK, &oldset, 0);
+
+	state.SetItemsProcessed(state.iterations() * BENCH_SIGNAL_BATCH);
+}
+BENCHMARK(BM_signalfd_throughput);
@@ -0,0 +1,77 @@
+// Events per second at large connection counts, which shows how many cache lines of fdepoller are touched
+// by the event path. Connections are fake (no syscalls) and they are served in random order as epoll_wait
+// would return them.
+
+#include <epoller/fdepoller.h>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#define BENCH_RXSIZE 64
+#define BENCH_FAKE_FD 1000000
+
+/// @brief Fake connection, it neither reads nor writes.
+struct layout_fdepoller : fdepoller
+{
+	layout_fdepoller(struct epoller *epoller) : fdepoller(epoller) {}
+
+	virtual ~layout_fdepoller()
+	{
+		linbuff_free(&rxbuff);
+		fd = -1; // nothing to be closed
+	}
+
+	virtual int epoll_in()
+	{
+		size_t len = linbuff_towr(&rxbuff);
+		linbuff_forward(&rxbuff, len);
+		return rx(len);
+	}
+};
+
+/// @brief Receiver of fake connections.
+struct layout_receiver : fdepoller::receiver
+{
+	virtual int rx(fdepoller &sender, int len)
+	{
+		linbuff_clear(&sender.rxbuff);
+		return 0;
+	}
+};
+
+static void BM_layout_events(benchmark::State &state)
+{
+	struct epoller ep;
+	struct epoll_event revent;
+	struct epoller_event *self;
+	layout_receiver rcvr;
+	std::vector<layout_fdepoller*> evs(state.range(0));
+	size_t i = 0;
+
+	for (auto &ev : evs) {
+		ev = new layout_fdepoller(&ep);
+		ev->fd  = BENCH_FAKE_FD;
+		ev->rcvr = &rcvr;
+		linbuff_alloc(&ev->rxbuff, BENCH_RXSIZE);
+	}
+	std::shuffle(evs.begin(), evs.end(), std::mt19937(1));
+
+	for (auto _ : state) {
+		layout_fdepoller *ev = evs[i];
+		if (++i == evs.size())
+			i = 0;
+		self = ev;
+		ev->pthis = &self;
+		revent.events   = EPOLLIN;
+		revent.data.ptr = ev;
+		benchmark::DoNotOptimize(ev->handler(&ep, &revent));
+		ev->pthis = 0;
+	}
+
+	for (auto ev : evs)
+		delete ev;
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_layout_events)->Arg(1000)->Arg(10000)->Arg(100000)->Arg(1000000);
@@ -0,0 +1,215 @@
+/// @file   epoller/acceptor.h
+/// @author speedak
+/// @brief  TCP server accepting connections in one epoller and dispatching them to worker epollers.
+
+#ifndef ACCEPTOR_H
+#define ACCEPTOR_H
+
+#include <epoller/tcpsepoller.h>
+#include <epoller/evepoller.h>
+#include <epoller/timepoller.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <vector>
+
+/// @brief Default capacity of worker's ring of accepted connections.
+#define ACCEPTOR_RING_SIZE 1024
+
+/// @brief Default maximum number of connections accepted within one EPOLLIN event.
+#define ACCEPTOR_BATCH 64
+
+/// @brief Default time in milliseconds for which accepting is suspended when file descriptors run out.
+#define ACCEPTOR_BACKOFF_MSEC 100
+
+/// @brief Worker receiving connections accepted by acceptor.
+///
+/// The worker lives in the thread running its parent epoller. Accepted file descriptors are handed over to it
+/// by the acceptor through single-producer single-consumer ring and the worker is woken up once per accepted batch.
+/// The worker passes them to the receiver (within its own thread), which builds connection objects locally.
+struct acceptor_worker : evepoller::receiver
+{
+	/// @brief Event receiver interface.
+	struct receiver
+	{
+		/// @brief Destructor.
+		virtual ~receiver() {}
+
+		/// @brief Called when accepted connection is handed over to the worker.
+		///        Default implementation closes the file descriptor and returns -1.
+		/// @param sender event sender
+		/// @param fd file descriptor of accepted non-blocking socket (owned by the receiver)
+		/// @param addr peer socket address
+		/// @param addrlen size of peer socket address
+		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+		virtual int acc(acceptor_worker &sender, int fd, const struct sockaddr *addr, socklen_t addrlen);
+	};
+
+	/// @brief Slot of the ring.
+	struct slot
+	{
+		int                     fd;      ///< file descriptor of accepted socket
+		socklen_t               addrlen; ///< size of peer socket address
+		struct sockaddr_storage addr;    ///< peer socket address
+	};
+
+	struct epoller      *epoller; ///< parent epoller
+	evepoller            wakeup;  ///< wakes up the parent epoller when some connections are handed over
+	std::vector<slot>    ring;    ///< ring of accepted connections (size is power of two)
+	std::atomic<size_t>  head;    ///< position of the next slot to be read (written by the worker)
+	std::atomic<size_t>  tail;    ///< position of the next slot to be written (written by the acceptor)
+	std::atomic<long>    conns;   ///< number of active connections (see #closed)
+	struct receiver     *rcvr;    ///< event receiver
+
+	/// @brief Called when accepted connection is handed over to the worker.
+	/// @param sender event sender
+	/// @param fd file descriptor of accepted non-blocking socket (owned by the receiver)
+	/// @param addr peer socket address
+	/// @param addrlen size of peer socket address
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int (*_acc) (acceptor_worker &sender, int fd, const struct sockaddr *addr, socklen_t addrlen);
+
+	/// @brief Constructor.
+	/// @param epoller parent epoller
+	acceptor_worker(struct epoller *epoller) :
+	    epoller (epoller),
+	    wakeup  (epoller),
+	    ring    (       ),
+	    head    (0      ),
+	    tail    (0      ),
+	    conns   (0      ),
+	    rcvr    (0      ),
+	    _acc    (0      )
+	{}
+
+	/// @brief Destructor.
+	virtual ~acceptor_worker() {cleanup();}
+
+	/// @brief Initializes the worker.
+	/// @param size capacity of the ring (rounded up to power of two)
+	/// @return @c true if initialization was successful, otherwise @c false
+	virtual bool init(size_t size = ACCEPTOR_RING_SIZE);
+
+	/// @brief Cleanups the worker, connections not handed over yet are closed.
+	virtual void cleanup();
+
+	/// @brief Gets number of connections waiting in the ring.
+	size_t queued() const {return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);}
+
+	/// @brief Pushes accepted connection to the ring (called by the acceptor).
+	/// @return @c true if the connection has been pushed, @c false if the ring is full
+	bool push(int fd, const struct sockaddr_storage *addr, socklen_t addrlen);
+
+	/// @brief Announces that a connection handed over by #acc has been closed (for least connections policy).
+	void closed() {conns.fetch_sub(1, std::memory_order_relaxed);}
+
+	/// @brief Hands over connections from the ring.
+	/// @copydoc evepoller::receiver::recv_handler
+	virtual int recv_handler(evepoller &sender, uint64_t cnt);
+
+	/// @brief Called when accepted connection is handed over to the worker.
+	///
+	/// Default implementation calls receiver::acc method of #rcvr if not null,
+	/// otherwise calls #_acc if not null,
+	/// otherwise closes the file descriptor and returns -1.
+	///
+	/// @param fd file descriptor of accepted non-blocking socket (owned by the receiver)
+	/// @param addr peer socket address
+	/// @param addrlen size of peer socket address
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int acc(int fd, const struct sockaddr *addr, socklen_t addrlen);
+};
+
+/// @brief Policy choosing worker for accepted connection.
+struct acceptor_policy
+{
+	/// @brief Destructor.
+	virtual ~acceptor_policy() {}
+
+	/// @brief Chooses worker.
+	/// @param workers workers (not empty)
+	/// @return index of the chosen worker
+	virtual size_t pick(const std::vector<acceptor_worker*> &workers) = 0;
+};
+
+/// @brief Round-robin policy.
+struct acceptor_round_robin : acceptor_policy
+{
+	size_t next; ///< index of the next worker
+
+	/// @brief Constructor.
+	acceptor_round_robin() : next(0) {}
+
+	/// @copydoc acceptor_policy::pick
+	virtual size_t pick(const std::vector<acceptor_worker*> &workers);
+};
+
+/// @brief Least connections policy (see acceptor_worker::closed).
+struct acceptor_least_conns : acceptor_policy
+{
+	/// @copydoc acceptor_policy::pick
+	virtual size_t pick(const std::vector<acceptor_worker*> &workers);
+};
+
+/// @brief Least queue depth policy, prefers workers, which take over handed connections fastest.
+struct acceptor_least_queue : acceptor_policy
+{
+	/// @copydoc acceptor_policy::pick
+	virtual size_t pick(const std::vector<acceptor_worker*> &workers);
+};
+
+/// @brief TCP server accepting connections in batches and dispatching them to workers.
+///
+/// It may be initialized either by tcpsepoller::socket or by fdepoller::init with a listening socket
+/// (e.g. inherited from service manager), which must be non-blocking.
+///
+/// When accepting fails for lack of file descriptors or memory (EMFILE, ENFILE, ENOBUFS, ENOMEM), the pending
+/// connection stays in the listen queue, so the level-triggered socket would be reported again immediately.
+/// Therefore the acceptor is removed from parent epoller and it is added back by #backoff_timer
+/// after #backoff_msec milliseconds.
+struct acceptor : tcpsepoller, timepoller::receiver
+{
+	std::vector<acceptor_worker*> workers;       ///< workers (all must be added before the epoller starts running)
+	struct acceptor_policy       *policy;        ///< dispatching policy (not owned), zero for round-robin
+	unsigned int                  batch;         ///< maximum number of connections accepted within one EPOLLIN event
+	unsigned long                 accepted;      ///< number of accepted connections
+	unsigned long                 dropped;       ///< number of connections closed, because rings of all workers were full
+	unsigned int                  backoff_msec;  ///< time for which accepting is suspended when resources run out
+	unsigned long                 backoff_cnt;   ///< number of times accepting has been suspended
+	timepoller                    backoff_timer; ///< timer resuming suspended accepting
+	std::vector<bool>             woken;         ///< workers woken up within current batch (kept to avoid allocation)
+	acceptor_round_robin          rr;            ///< default policy
+
+	/// @brief Constructor.
+	/// @param epoller parent epoller
+	acceptor(struct epoller *epoller) :
+	    tcpsepoller   (epoller              ),
+	    workers       (                     ),
+	    policy        (0                    ),
+	    batch         (ACCEPTOR_BATCH       ),
+	    accepted      (0                    ),
+	    dropped       (0                    ),
+	    backoff_msec  (ACCEPTOR_BACKOFF_MSEC),
+	    backoff_cnt   (0                    ),
+	    backoff_timer (epoller              ),
+	    woken         (                     ),
+	    rr            (                     )
+	{}
+
+	/// @brief Destructor.
+	virtual ~acceptor() {backoff_timer.cleanup();}
+
+	/// @brief Accepts up to #batch connections, pushes them to workers chosen by #policy
+	///        and wakes up every affected worker once.
+	/// @see sockepoller::epoll_in
+	virtual int epoll_in();
+
+	/// @brief Suspends accepting for #backoff_msec milliseconds.
+	/// @return @c true if suspending was successful, otherwise @c false
+	bool backoff();
+
+	/// @brief Resumes suspended accepting.
+	/// @copydoc timepoller::receiver::timerhandler
+	virtual int timerhandler(timepoller &sender, uint64_t exp);
+};
+
+#endif // ACCEPTOR_H
@@ -0,0 +1,58 @@
+/// @file   epoller/balancer.h
+/// @author speedak
+/// @brief  Load balancer of epollers running in different threads.
+
+#ifndef BALANCER_H
+#define BALANCER_H
+
+#include <epoller/migrator.h>
+#include <cstddef>
+#include <vector>
+
+/// @brief Load balancer.
+///
+/// Every migrator added by migrator::balance periodically samples load of its epoller and calls #rebalance
+/// from its thread. If the load of the migrator's epoller exceeds the load of the least loaded epoller by more than
+/// #threshold, some adopted events (see migrator::adopt) are migrated there.
+///
+/// All migrators must be added before their epollers start running.
+struct balancer
+{
+	/// @brief Load metric.
+	enum metric
+	{
+		CPU,    ///< CPU time of the thread running the epoller per second of real time
+		EVENTS  ///< number of handled events per second
+	};
+
+	std::vector<migrator*> loops;     ///< balanced migrators
+	enum metric            metric;    ///< load metric
+	double                 threshold; ///< relative load difference, which triggers migration
+	double                 min_load;  ///< load, below which no events are migrated
+	size_t                 batch;     ///< maximum number of events migrated by one migrator within one period
+
+	/// @brief Constructor.
+	/// @param metric load metric
+	balancer(enum metric metric = CPU) :
+	    loops     (                          ),
+	    metric    (metric                    ),
+	    threshold (0.25                      ),
+	    min_load  (metric == CPU ? 0.1 : 1000),
+	    batch     (16                        )
+	{}
+
+	/// @brief Destructor.
+	virtual ~balancer() {}
+
+	/// @brief Migrates events from the epoller of given migrator to the least loaded epoller if needed.
+	///        It is called from the thread running the epoller of the migrator.
+	///
+	/// Default implementation moves as many events as would halve the load difference, provided that
+	/// events generate equal load, but not more than #batch.
+	///
+	/// @param source migrator, whose load has been just sampled
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int rebalance(migrator &source);
+};
+
+#endif // BALANCER_H
@@ -0,0 +1,163 @@
+/// @file   epoller/basic_fdepoller.h
+/// @author speedak
+/// @brief  File descriptor epoller with compile-time event dispatch.
+
+#ifndef BASIC_FDEPOLLER_H
+#define BASIC_FDEPOLLER_H
+
+#include <epoller/fdepoller.h>
+#include <epoller/log.h>
+#include <unistd.h>
+#include <errno.h>
+
+/// @brief Event receiver base for basic_fdepoller.
+///
+/// Unlike fdepoller::receiver it has no virtual methods. A receiver derives from it and hides the methods it is
+/// interested in, the rest keeps the default behaviour (returns -1 as fdepoller::receiver does).
+///
+/// @tparam Sender type of the event sender
+template <typename Sender>
+struct basic_fdepoller_receiver
+{
+	/// @copydoc fdepoller::receiver::rx
+	int rx(Sender &sender, int len) {return -1;}
+
+	/// @copydoc fdepoller::receiver::tx
+	int tx(Sender &sender, int len) {return -1;}
+
+	/// @copydoc fdepoller::receiver::pri
+	int pri(Sender &sender) {return -1;}
+
+	/// @copydoc fdepoller::receiver::hup
+	int hup(Sender &sender) {return -1;}
+
+	/// @copydoc fdepoller::receiver::err
+	int err(Sender &sender) {return -1;}
+};
+
+/// @brief File descriptor epoller with compile-time event dispatch.
+///
+/// The only virtual call per event is epoller_event::handler called by epoller. The whole I/O path
+/// (reading into #rxbuff, writing from #txbuff) and the call of the receiver are bound at compile time,
+/// so the compiler can inline them. There is no check of fdepoller::rcvr, fdepoller::_rx and so on.
+///
+/// Derived class may hide do_read and do_write to use another syscall (e.g. recv and send).
+///
+/// Queued file regions (fdepoller::write_file), framing (fdepoller::frmr) and reception budgets
+/// are not supported in this path.
+///
+/// @tparam Derived the derived class (CRTP)
+/// @tparam Receiver receiver type providing rx, tx, pri, hup and err methods (see basic_fdepoller_receiver)
+/// @tparam Base base epoller class, fdepoller or derived from it
+template <typename Derived, typename Receiver, typename Base = fdepoller>
+struct basic_fdepoller : Base
+{
+	Receiver *target; ///< event receiver
+
+	/// @brief Constructor.
+	/// @param epoller parent epoller
+	/// @param target event receiver (must not be null while events are dispatched)
+	basic_fdepoller(struct epoller *epoller, Receiver *target) : Base(epoller), target(target) {}
+
+	/// @brief Destructor.
+	virtual ~basic_fdepoller() {}
+
+	/// @brief Reads from file descriptor to #rxbuff.
+	/// @return the same as read syscall
+	ssize_t do_read()
+	{
+		return read(this->fd, LINBUFF_WR_PTR(&this->rxbuff), linbuff_towr(&this->rxbuff));
+	}
+
+	/// @brief Writes from #txbuff to file descriptor.
+	/// @return the same as write syscall
+	ssize_t do_write()
+	{
+		return write(this->fd, LINBUFF_RD_PTR(&this->txbuff), linbuff_tord(&this->txbuff));
+	}
+
+	/// @copydoc epoller_event::handler
+	virtual int handler(struct epoller *epoller, struct epoll_event *revent)
+	{
+		int ret;
+		ssize_t len;
+		Derived &self = static_cast<Derived &>(*this);
+		struct epoller_event **pthis = epoller_event::pthis;
+
+		if (!target) {
+			ELOG(ELOG_ERROR, "basic_fdepoller: no event receiver");
+			revent->events = 0;
+			return -1;
+		}
+
+		if (revent->events & EPOLLIN) {
+			revent->events &= ~EPOLLIN;
+			this->epoll_in_cnt++;
+			len = self.do_read();
+			if (len > 0)
+				linbuff_forward(&this->rxbuff, len);
+			else if (len < 0)
+				ELOG_ERRNO(errno == EAGAIN ? ELOG_DEBUG : ELOG_ERROR, "basic_fdepoller: reading from file descriptor failed");
+			ret = target->rx(self, len < 0 ? -1 : len);
+			if (ret || !*pthis || this->fd == -1)
+				return ret;
+		}
+
+		if (revent->events & EPOLLOUT) {
+			revent->events &= ~EPOLLOUT;
+			this->epoll_out_cnt++;
+			len = self.do_write();
+			if (len > 0)
+				linbuff_skip(&this->txbuff, len);
+			else if (len < 0)
+				ELOG_ERRNO(errno == EAGAIN ? ELOG_DEBUG : ELOG_ERROR, "basic_fdepoller: writing to file descriptor failed");
+			ret = target->tx(self, len < 0 ? -1 : len);
+			if (ret || !*pthis || this->fd == -1)
+				return ret;
+		}
+
+		if (revent->events & EPOLLPRI) {
+			revent->events &= ~EPOLLPRI;
+			this->epoll_pri_cnt++;
+			ret = target->pri(self);
+			if (ret || !*pthis || this->fd == -1)
+				return ret;
+		}
+
+		if (revent->events & EPOLLHUP) {
+			revent->events &= ~EPOLLHUP;
+			this->epoll_hup_cnt++;
+			ret = target->hup(self);
+			if (ret || !*pthis || this->fd == -1)
+				return ret;
+		}
+
+		if (revent->events & EPOLLERR) {
+			revent->events &= ~EPOLLERR;
+			this->epoll_err_cnt++;
+			ret = target->err(self);
+			if (ret || !*pthis || this->fd == -1)
+				return ret;
+		}
+
+		if (linbuff_towr(&this->rxbuff)) {
+			if (this->enabled && this->rx_auto_enable && !this->enable_rx())
+				return -1;
+		} else {
+			if (this->enabled && this->rx_auto_disable && !this->disable_rx())
+				return -1;
+		}
+
+		if (linbuff_tord(&this->txbuff)) {
+			if (this->enabled && this->tx_auto_enable && !this->enable_tx())
+				return -1;
+		} else {
+			if (this->enabled && this->tx_auto_disable && !this->disable_tx())
+				return -1;
+		}
+
+		return 0;
+	}
+};
+
+#endif // BASIC_FDEPOLLER_H
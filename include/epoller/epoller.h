@@ -6,6 +6,7 @@
 #define EPOLLER_H
 
 #include <cstddef>
+#include <vector>
 #include <sys/epoll.h>
 
 /// @brief Default number of events returned from epoll_wait.
@@ -44,16 +45,47 @@ struct epoller_event
 	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
 	virtual int handler(struct epoller *epoller, struct epoll_event *revent) = 0;
 
+	/// @brief Called just before epoll_wait entry if the event has been added by epoller::add_flush.
+	///        The event is removed from the flush list before the call, but it may add itself again.
+	///        Default implementation returns 0.
+	/// @param epoller epoller within that the event is flushed
+	/// @param timeout epoll timeout in milliseconds, it may be lowered if the event needs to be flushed again later
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int flush(struct epoller *epoller, int *timeout) {(void) epoller; (void) timeout; return 0;}
+
+	/// @brief Detaches the event from its epoller, so it may be attached to another epoller (possibly running
+	///        in another thread).
+	///
+	/// It must be called from the thread running the current epoller. If it is called from within the handler
+	/// of the event, the handler returns without touching the event any more. The detached event must not be used
+	/// until it is attached again. Default implementation returns @c false (detaching is not supported).
+	///
+	/// @return @c true if the event has been detached, otherwise @c false
+	virtual bool detach() {return false;}
+
+	/// @brief Attaches the detached event to given epoller.
+	///        It must be called from the thread running the given epoller.
+	///        Default implementation returns @c false (attaching is not supported).
+	/// @param epoller new parent epoller
+	/// @return @c true if the event has been attached, otherwise @c false
+	virtual bool attach(struct epoller *epoller) {(void) epoller; return false;}
+
 };
 
 /// @brief Epoll wrapper.
 struct epoller
 {
-	int                 fd;           ///< epoll file descriptor
-	int                 timeout;      ///< epoll timeout in milliseconds (-1 for block indefinitely, 0 for return immediately)
-	int                 loop_exit;    ///< zero for loop continuation, positive for normal loop exit, negative for loop exit with error
-	size_t              revents_size; ///< size of array for returned events
-	struct epoll_event *revents;      ///< array for returned events
+	int                 fd;             ///< epoll file descriptor
+	int                 timeout;        ///< epoll timeout in milliseconds (-1 for block indefinitely, 0 for return immediately)
+	int                 loop_exit;      ///< zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	size_t              revents_size;   ///< size of array for returned events
+	struct epoll_event *revents;        ///< array for returned events
+	size_t              rx_budget;      ///< maximum number of bytes received within one loop iteration (zero for unlimited)
+	size_t              rx_budget_left; ///< number of bytes which may be still received within current loop iteration
+	size_t              rx_deferred;    ///< number of events whose reception has been deferred to next loop iteration
+	unsigned long       handled_cnt;    ///< number of events passed to handlers
+
+	std::vector<struct epoller_event*> flushes; ///< events to be flushed just before next epoll_wait
 
 	/// @brief Called when epoll timeout occurs.
 	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
@@ -80,6 +112,11 @@ struct epoller
 	    loop_exit         ( 0                                   ),
 	    revents_size      (EPOLLER_REVENTS_SIZE                 ),
 	    revents           (new epoll_event[EPOLLER_REVENTS_SIZE]),
+	    rx_budget         ( 0                                   ),
+	    rx_budget_left    ( 0                                   ),
+	    rx_deferred       ( 0                                   ),
+	    handled_cnt       ( 0                                   ),
+	    flushes           (                                     ),
 	    timeout_handler   ( 0                                   ),
 	    pre_epoll_handler ( 0                                   ),
 	    post_epoll_handler( 0                                   ),
@@ -94,6 +131,11 @@ struct epoller
 	    loop_exit         ( 0                           ),
 	    revents_size      (revents_size                 ),
 	    revents           (new epoll_event[revents_size]),
+	    rx_budget         ( 0                           ),
+	    rx_budget_left    ( 0                           ),
+	    rx_deferred       ( 0                           ),
+	    handled_cnt       ( 0                           ),
+	    flushes           (                             ),
 	    timeout_handler   ( 0                           ),
 	    pre_epoll_handler ( 0                           ),
 	    post_epoll_handler( 0                           ),
@@ -118,6 +160,25 @@ struct epoller
 	/// @return @c true for normal exit, @c false for exit caused by some error
 	virtual bool loop();
 
+	/// @brief Adds event to the flush list, so its epoller_event::flush is called just before next epoll_wait.
+	/// @param ev event to be added (must not be in the list already)
+	void add_flush(struct epoller_event *ev) {flushes.push_back(ev);}
+
+	/// @brief Removes event from the flush list.
+	/// @param ev event to be removed
+	void del_flush(struct epoller_event *ev);
+
+	/// @brief Dispatches events returned from epoll_wait (stored in #revents) to their handlers.
+	///        It is used by #loop and by loops driven from outside (e.g. glib source, see epoller_gsource).
+	/// @param n number of returned events
+	/// @return zero for loop continuation, otherwise #loop_exit is set and returned
+	int dispatch(int n);
+
+	/// @brief Flushes all events in the flush list.
+	/// @param timeout epoll timeout in milliseconds, it may be lowered by flushed events
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int flush(int *timeout);
+
 	/// @brief Exits from the epoller's looper.
 	/// @param how positive for normal loop exit, negative for loop exit with error
 	virtual void exit(int how);
@@ -0,0 +1,207 @@
+/// @file   epoller/fanepoller.h
+/// @author speedak
+/// @brief  Fanotify file descriptor wrapper.
+
+#ifndef FANEPOLLER_H
+#define FANEPOLLER_H
+
+#include <epoller/epoller.h>
+#include <sys/fanotify.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/// @brief Default size of buffer for read events.
+#define FANEPOLLER_BUFF_SIZE 65536
+
+#ifdef FAN_REPORT_DFID_NAME
+/// @brief Flags of fanotify_init making events identify objects by file handles.
+#define FANEPOLLER_REPORT_FLAGS (FAN_REPORT_FID | FAN_REPORT_DFID_NAME)
+#else
+/// @brief Flags of fanotify_init making events identify objects by file handles.
+#define FANEPOLLER_REPORT_FLAGS (FAN_REPORT_FID)
+#endif
+
+/// @brief Default flags passed to fanotify_init.
+#define FANEPOLLER_INIT_FLAGS (FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FANEPOLLER_REPORT_FLAGS)
+
+/// @brief Fanotify epoller.
+///
+/// It watches whole mounts or filesystems by single mark (see #mark) instead of one watch per directory.
+/// All events queued in the fanotify file descriptor are read at once (as many as fit into #buff) and dispatched
+/// one by one. If a callback returns nonzero, events not dispatched yet are kept in #buff and they are dispatched
+/// before the next read (just before next epoll_wait at the latest).
+///
+/// If the kernel supports FAN_REPORT_FID / FAN_REPORT_DFID_NAME, events identify objects by file handles
+/// (and entry names), which are cheap to report. They are resolved to paths only on demand by #resolve
+/// (by open_by_handle_at, which needs CAP_DAC_READ_SEARCH). Otherwise events carry file descriptors opened
+/// by the kernel, which are closed right after the event is dispatched (or by #cleanup if it is not dispatched).
+struct fanepoller : epoller_event
+{
+	/// @brief Event passed to receivers, valid only during the call.
+	struct fan_event
+	{
+		const struct fanotify_event_metadata *meta; ///< event metadata (mask, pid, fd)
+		const struct fanotify_event_info_fid *fid;  ///< file handle of the object, null if not reported
+		const struct fanotify_event_info_fid *dfid; ///< file handle of the parent directory, null if not reported
+		const char                           *name; ///< entry name within the parent directory, null if not reported
+	};
+
+	/// @brief Event receiver interface.
+	struct receiver
+	{
+		/// @brief Destructor.
+		virtual ~receiver() {}
+
+		/// @brief Called when event occurs.
+		///        Default implementation returns -1.
+		/// @param sender event sender
+		/// @param event the occurred event
+		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+		virtual int fanhandler(fanepoller &sender, const struct fan_event *event);
+
+		/// @brief Called when event queue has overflowed (FAN_Q_OVERFLOW), so some events have been lost.
+		///        Default implementation calls fanhandler.
+		/// @param sender event sender
+		/// @param event the occurred event
+		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+		virtual int overflow(fanepoller &sender, const struct fan_event *event);
+	};
+
+	int                               fd;           ///< fanotify file descriptor
+	struct epoller                   *epoller;      ///< parent epoller
+	struct epoll_event                event;        ///< epoll event
+	struct receiver                  *rcvr;         ///< event receiver
+	unsigned int                      flags;        ///< flags the fanotify file descriptor has been created with
+	std::vector<uint8_t>              buff;         ///< buffer for read events
+	size_t                            buff_pos;     ///< offset of the first read event not dispatched yet
+	size_t                            buff_len;     ///< length of read events in #buff
+	bool                              queued;       ///< added to flush list of parent epoller (see #flush)
+	std::unordered_map<uint64_t, int> mounts;       ///< file descriptors of marked filesystems by their IDs (for #resolve)
+	unsigned long                     overflow_cnt; ///< FAN_Q_OVERFLOW counter
+
+	/// @brief Called when event occurs.
+	/// @param sender event sender
+	/// @param event the occurred event
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int (*_fanhandler) (fanepoller &sender, const struct fan_event *event);
+
+	/// @brief Called when event queue has overflowed (FAN_Q_OVERFLOW), so some events have been lost.
+	/// @param sender event sender
+	/// @param event the occurred event
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int (*_overflow) (fanepoller &sender, const struct fan_event *event);
+
+	/// @brief Constructor.
+	/// @param epoller parent epoller
+	fanepoller(struct epoller *epoller) :
+	    fd           (-1     ),
+	    epoller      (epoller),
+	    event        (       ),
+	    rcvr         (0      ),
+	    flags        (0      ),
+	    buff         (       ),
+	    buff_pos     (0      ),
+	    buff_len     (0      ),
+	    queued       (false  ),
+	    mounts       (       ),
+	    overflow_cnt (0      ),
+	    _fanhandler  (0      ),
+	    _overflow    (0      )
+	{}
+
+	/// @brief Default constructor.
+	fanepoller() : fanepoller(0) {}
+
+	/// @brief Destructor.
+	virtual ~fanepoller() {cleanup();}
+
+	/// @brief Initializes the fanotify epoller.
+	///
+	/// If the kernel does not support reporting of directory file handles and names (before 5.9), the fanotify
+	/// file descriptor is created with FAN_REPORT_FID only. If it does not support reporting of file handles
+	/// at all (before 5.1), the fanotify file descriptor is created without FAN_REPORT_* flags.
+	///
+	/// @param flags flags passed to fanotify_init
+	/// @param event_f_flags flags of file descriptors carried by events (if file handles are not reported)
+	/// @param buffsize size of buffer for read events in bytes
+	/// @return @c true if initialization was successful, otherwise @c false
+	virtual bool init(unsigned int flags = FANEPOLLER_INIT_FLAGS, unsigned int event_f_flags = O_RDONLY | O_CLOEXEC,
+	                  size_t buffsize = FANEPOLLER_BUFF_SIZE);
+
+	/// @brief Cleanups the fanotify epoller, file descriptors of events not dispatched yet are closed.
+	virtual void cleanup();
+
+	/// @brief Adds mark.
+	/// @param pathname marked pathname
+	/// @param mask mask with monitoring events (FAN_CREATE, FAN_MODIFY, FAN_CLOSE_WRITE, ..., FAN_ONDIR)
+	/// @param flags FAN_MARK_FILESYSTEM, FAN_MARK_MOUNT, zero for inode
+	/// @return @c true if adding was successful, otherwise @c false
+	bool mark(const std::string &pathname, uint64_t mask, unsigned int flags = FAN_MARK_FILESYSTEM);
+
+	/// @brief Removes mark.
+	/// @param pathname marked pathname
+	/// @param mask mask with monitoring events to be removed
+	/// @param flags flags the mark has been added with
+	/// @return @c true if removing was successful, otherwise @c false
+	bool unmark(const std::string &pathname, uint64_t mask, unsigned int flags = FAN_MARK_FILESYSTEM);
+
+	/// @brief Checks whether events identify objects by file handles.
+	bool reports_fid() const {return flags & FANEPOLLER_REPORT_FLAGS;}
+
+	/// @brief Resolves path of the event object.
+	///
+	/// The path is built from the parent directory and the entry name if they are reported, otherwise from
+	/// the object file handle or the file descriptor carried by the event. The object may have been renamed
+	/// or removed since the event occurred, so the path is the current one (if any).
+	///
+	/// @param event the event being handled
+	/// @param path resolved path
+	/// @return @c true if resolving was successful, otherwise @c false
+	bool resolve(const struct fan_event *event, std::string &path);
+
+	/// @brief Opens object identified by file handle.
+	/// @param fid file handle record of an event
+	/// @param flags flags passed to open_by_handle_at (O_PATH, O_RDONLY, ...)
+	/// @return file descriptor if opening was successful, otherwise -1
+	int open_fid(const struct fanotify_event_info_fid *fid, int flags = O_PATH);
+
+	/// @copydoc epoller_event::handler
+	virtual int handler(struct epoller *epoller, struct epoll_event *revent);
+
+	/// @brief Dispatches read events left undispatched by previous callback returning nonzero.
+	/// @copydoc epoller_event::flush
+	virtual int flush(struct epoller *epoller, int *timeout);
+
+	/// @brief Dispatches read events not dispatched yet.
+	///        If a callback returns nonzero, the rest is queued to be flushed.
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int dispatch();
+
+	/// @brief Drops read events not dispatched yet and closes file descriptors carried by them.
+	void drop();
+
+	/// @brief Called when event occurs.
+	///
+	/// Default implementation calls receiver::fanhandler method of #rcvr if not null,
+	/// otherwise calls #_fanhandler if not null,
+	/// otherwise returns -1.
+	///
+	/// @param event the occurred event
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int fanhandler(const struct fan_event *event);
+
+	/// @brief Called when event queue has overflowed (FAN_Q_OVERFLOW), so some events have been lost.
+	///
+	/// Default implementation calls receiver::overflow method of #rcvr if not null,
+	/// otherwise calls #_overflow if not null,
+	/// otherwise calls fanhandler.
+	///
+	/// @param event the occurred event
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int overflow(const struct fan_event *event);
+};
+
+#endif // FANEPOLLER_H
@@ -6,8 +6,12 @@
 #define FDEPOLLER_H
 
 #include <epoller/epoller.h>
+#include <epoller/framer.h>
 #include <linbuff/linbuff.h>
+#include <sys/types.h>
+#include <time.h>
 #include <string>
+#include <deque>
 
 /// @brief Generic file desciptor epoller.
 struct fdepoller : epoller_event
@@ -26,6 +30,15 @@ struct fdepoller : epoller_event
 		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
 		virtual int rx(fdepoller &sender, int len);
 
+		/// @brief Called if whole frame has just been received (only if #frmr is set).
+		///        The frame is located directly in #rxbuff and it is valid only during the call.
+		///        Default implementation returns -1.
+		/// @param sender event sender
+		/// @param data frame payload
+		/// @param len length of frame payload
+		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+		virtual int frame(fdepoller &sender, const uint8_t *data, size_t len);
+
 		/// @brief Called if some data have just been transmitted (from #txbuff)
 		///        or some error occurred during transmission.
 		///        Default implementation returns -1.
@@ -74,6 +87,15 @@ struct fdepoller : epoller_event
 		virtual int exit(fdepoller &sender, struct epoll_event *revent);
 	};
 
+	/// @brief File region queued for transmission.
+	struct txfile
+	{
+		int    fd;     ///< file descriptor of the file (not owned by the epoller)
+		off_t  offset; ///< offset of the region not transmitted yet
+		size_t len;    ///< length of the region not transmitted yet
+		size_t before; ///< number of bytes from #txbuff, which must be transmitted before the region
+	};
+
 	int                fd;              ///< file descriptor
 	struct epoller    *epoller;         ///< parent epoller
 	struct epoll_event event;           ///< epoll event
@@ -89,7 +111,18 @@ struct fdepoller : epoller_event
 	unsigned long      epoll_pri_cnt;   ///< EPOLLPRI counter
 	unsigned long      epoll_hup_cnt;   ///< EPOLLHUP counter
 	unsigned long      epoll_err_cnt;   ///< EPOLLERR counter
+	unsigned int       rx_budget_reads; ///< maximum number of reads per EPOLLIN event (see #epoll_in_budget)
+	size_t             rx_budget_bytes; ///< maximum number of bytes received per EPOLLIN event, zero means unlimited
+	size_t             rx_event_bytes;  ///< number of bytes received within current EPOLLIN event
+	bool               tx_cork;         ///< corked write mode (see #write_stream)
+	size_t             tx_cork_bytes;   ///< corked data are flushed immediately when reach this size, zero means unlimited
+	int                tx_cork_delay;   ///< corked data may be held over loop iterations up to this time in milliseconds
+	bool               tx_corked;       ///< some corked data are waiting for flush (added to parent epoller's flush list)
+	struct timespec    tx_cork_time;    ///< time of the first corked write (CLOCK_MONOTONIC)
 	struct receiver   *rcvr;            ///< event receiver
+	struct framer     *frmr;            ///< rx framer (not owned by the epoller), if set frames are delivered instead of raw data
+	std::deque<txfile> txfiles;         ///< file regions queued for transmission
+	bool               attach_enabled;  ///< enabled state to be restored by #attach
 
 	/// @brief Called if new data have just been received (to #rxbuff)
 	///        or some error occurred during reception.
@@ -98,6 +131,14 @@ struct fdepoller : epoller_event
 	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
 	int (*_rx) (fdepoller &sender, int len);
 
+	/// @brief Called if whole frame has just been received (only if #frmr is set).
+	///        The frame is located directly in #rxbuff and it is valid only during the call.
+	/// @param sender event sender
+	/// @param data frame payload
+	/// @param len length of frame payload
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int (*_frame) (fdepoller &sender, const uint8_t *data, size_t len);
+
 	/// @brief Called if some data have just been transmitted (from #txbuff)
 	///        or some error occurred during transmission.
 	/// @param sender event sender
@@ -156,8 +197,20 @@ struct fdepoller : epoller_event
 	    epoll_pri_cnt   (0      ),
 	    epoll_hup_cnt   (0      ),
 	    epoll_err_cnt   (0      ),
+	    rx_budget_reads (1      ),
+	    rx_budget_bytes (0      ),
+	    rx_event_bytes  (0      ),
+	    tx_cork         (false  ),
+	    tx_cork_bytes   (0      ),
+	    tx_cork_delay   (0      ),
+	    tx_corked       (false  ),
+	    tx_cork_time    (       ),
 	    rcvr            (0      ),
+	    frmr            (0      ),
+	    txfiles         (       ),
+	    attach_enabled  (false  ),
 	    _rx             (0      ),
+	    _frame          (0      ),
 	    _tx             (0      ),
 	    _pri            (0      ),
 	    _hup            (0      ),
@@ -275,10 +328,32 @@ struct fdepoller : epoller_event
 	/// otherwise calls #_rx if not null,
 	/// otherwise returns -1.
 	///
+	/// If #frmr is set, received data are passed to rx_frames instead.
+	///
 	/// @param len length of just received data if zero or positive, error state if negative
 	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
 	virtual int rx(int len);
 
+	/// @brief Called if whole frame has just been received (only if #frmr is set).
+	///
+	/// Default implementation calls receiver::frame method of #rcvr if not null,
+	/// otherwise calls #_frame if not null,
+	/// otherwise returns -1.
+	///
+	/// @param data frame payload (located directly in #rxbuff and valid only during the call)
+	/// @param len length of frame payload
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int frame(const uint8_t *data, size_t len);
+
+	/// @brief Splits data in #rxbuff into frames by #frmr and calls frame for each whole one.
+	///
+	/// Delivered frames are skipped in #rxbuff. Then #rxbuff is compacted only if the incomplete frame
+	/// does not fit into the rest of the buffer and it is enlarged only if the frame does not fit into
+	/// the whole buffer (up to framer::max_size).
+	///
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int rx_frames();
+
 	/// @brief Called if some data have just been transmitted (from #txbuff)
 	/// or some error occurred during transmission.
 	///
@@ -352,8 +427,27 @@ struct fdepoller : epoller_event
 	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
 	virtual int epoll_in();
 
+	/// @brief Calls epoll_in repeatedly within the reception budget.
+	///
+	/// The epoll_in is called again while it filled all free space of #rxbuff (so more data are likely pending),
+	/// while number of calls is less then #rx_budget_reads, while less then #rx_budget_bytes bytes have been
+	/// received and while global budget of parent epoller (epoller::rx_budget) is not exhausted.
+	/// If the reception is stopped by a budget, epoller::rx_deferred is incremented, so the next epoll_wait
+	/// does not block and the remaining data are received in the next loop iteration.
+	///
+	/// Setting #rx_budget_reads greater than one makes sense only for non-blocking file descriptors.
+	///
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int epoll_in_budget();
+
+	/// @brief Charges just received bytes to the reception budgets.
+	///        Should be called by epoll_in implementations before rx is called.
+	/// @param len number of just received bytes
+	void rx_charge(size_t len);
+
 	/// @brief EPOLLOUT event handler.
-	///        Default implementation writes to #fd from #txbuff and then calls tx.
+	///        Default implementation writes to #fd from #txbuff and then calls tx
+	///        (if data are corked, it just disables transmitting, see #tx_cork).
 	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
 	virtual int epoll_out();
 
@@ -382,6 +476,11 @@ struct fdepoller : epoller_event
 	///        At first the bytes are written direct to file descriptor (but only if linear buffer is empty),
 	///        secondly the remaining bytes are written to linear buffer.
 	///        This method may block, but only during direct writing to file descriptor, which is marked as blocking.
+	///
+	///        If #tx_cork is set, the bytes are only written to linear buffer and they are flushed (by single write)
+	///        just before next epoll_wait of parent epoller, or later if #tx_cork_delay is set, or immediately if
+	///        #tx_cork_bytes are pending.
+	///
 	/// @param buff buffer
 	/// @param len length of buffer
 	/// @return number of written bytes (>=0) or -1 if something failed
@@ -398,6 +497,61 @@ struct fdepoller : epoller_event
 	/// @return number of written bytes (=0 or =len) or -1 if something failed
 	virtual ssize_t write_dgram(const void *buff, size_t len);
 
+	/// @brief Writes pending data (from #txbuff up to next queued file region) directly to file descriptor
+	///        and enables transmitting if some data are still pending.
+	/// @return number of written bytes (>=0) or -1 if something failed
+	ssize_t tx_uncork();
+
+	/// @brief Flushes corked data (see #tx_cork).
+	///        The data are held corked until #tx_cork_delay elapses, then tx_uncork is called.
+	/// @copydoc epoller_event::flush
+	virtual int flush(struct epoller *epoller, int *timeout);
+
+	/// @brief Detaches the file descriptor epoller from parent epoller.
+	///        The file descriptor, buffers, pending data and queued file regions are kept, corked data are
+	///        flushed after attaching. Everything else, which is registered in the parent epoller (e.g. timers
+	///        of derived classes), must be detached by overriding this method.
+	/// @copydoc epoller_event::detach
+	virtual bool detach();
+
+	/// @brief Attaches the file descriptor epoller to given epoller and restores its enabled state.
+	/// @copydoc epoller_event::attach
+	virtual bool attach(struct epoller *epoller);
+
+	/// @brief Writes file region in stream way.
+	///        At first the region is transmitted direct to file descriptor by #send_file (but only if there are
+	///        no pending data), secondly the remaining part of the region is queued to #txfiles.
+	///        Queued regions are transmitted in order with data written by #write_stream when file descriptor
+	///        becomes writable. The file descriptor of the file must stay open until the region is transmitted.
+	/// @param fd file descriptor of the file
+	/// @param offset offset of the region
+	/// @param len length of the region
+	/// @return number of bytes transmitted directly (>=0) or -1 if something failed
+	virtual ssize_t write_file(int fd, off_t offset, size_t len);
+
+	/// @brief Transmits file region direct to file descriptor.
+	///        Default implementation uses copy_file_range syscall and falls back to sendfile syscall
+	///        for file descriptors, which are not regular files.
+	/// @param in_fd file descriptor of the file
+	/// @param offset offset of the region, it is updated by number of transmitted bytes
+	/// @param len length of the region
+	/// @return number of transmitted bytes (>=0) or -1 if something failed
+	virtual ssize_t send_file(int in_fd, off_t *offset, size_t len);
+
+	/// @brief Transmits front of #txfiles queue, if it is the next one to be transmitted, and then calls tx.
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int epoll_out_file();
+
+	/// @brief Gets number of bytes from #txbuff, which may be transmitted before the next queued file region.
+	size_t tx_chunk() const;
+
+	/// @brief Skips transmitted bytes in #txbuff.
+	/// @param len number of transmitted bytes
+	void tx_skip(size_t len);
+
+	/// @brief Checks whether there are some data or file regions pending for transmission.
+	bool tx_pending() const {return linbuff_tord(&txbuff) || !txfiles.empty();}
+
 	/// @copydoc epoller_event::handler
 	virtual int handler(struct epoller *epoller, struct epoll_event *revent);
 };
@@ -0,0 +1,119 @@
+/// @file   epoller/fdrelay.h
+/// @author speedak
+/// @brief  Zero-copy relay between two file descriptor epollers.
+
+#ifndef FDRELAY_H
+#define FDRELAY_H
+
+#include <epoller/fdepoller.h>
+
+/// @brief Default maximum number of bytes moved by one splice call.
+#define FDRELAY_CHUNK_SIZE 65536
+
+/// @brief Zero-copy relay between two file descriptor epollers.
+///
+/// Data are moved in both directions through intermediate pipes by splice syscall,
+/// so they never enter user space (#fdepoller::rxbuff and #fdepoller::txbuff are not used at all).
+/// The relay becomes receiver of both epollers and consumes all their EPOLLIN, EPOLLOUT and EPOLLHUP events.
+///
+/// While the sink of the direction is blocked, reception on the source is disabled (backpressure).
+/// When the source reaches end of file and all its data have been moved, the write side of the sink is shut down
+/// (half-close). When both directions are finished (or some error occurs), #done is called.
+struct fdrelay : fdepoller::receiver
+{
+	/// @brief Event receiver interface.
+	struct receiver
+	{
+		/// @brief Destructor.
+		virtual ~receiver() {}
+
+		/// @brief Called when relaying is finished.
+		///        Default implementation returns -1.
+		/// @param sender event sender
+		/// @param error zero if both directions were finished normally, otherwise -1 and errno is set appropriately
+		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+		virtual int done(fdrelay &sender, int error);
+	};
+
+	/// @brief One direction of the relay.
+	struct direction
+	{
+		fdepoller     *src;     ///< source epoller
+		fdepoller     *dst;     ///< sink epoller
+		int            pfd[2];  ///< intermediate pipe
+		size_t         pending; ///< number of bytes pending in the pipe
+		bool           eof;     ///< end of file reached on the source
+		bool           hup;     ///< hang-up occurred on the source
+		bool           shut;    ///< write side of the sink has been shut down
+		unsigned long  bytes;   ///< number of bytes moved to the sink
+
+		/// @brief Constructor.
+		direction() : src(0), dst(0), pfd(), pending(0), eof(false), hup(false), shut(false), bytes(0) {pfd[0] = pfd[1] = -1;}
+	};
+
+	struct direction  dirs[2]; ///< directions (first to second epoller and vice versa)
+	size_t            chunk;   ///< maximum number of bytes moved by one splice call
+	bool              active;  ///< relaying is in progress
+	struct receiver  *rcvr;    ///< event receiver
+
+	/// @brief Called when relaying is finished.
+	/// @param sender event sender
+	/// @param error zero if both directions were finished normally, otherwise -1 and errno is set appropriately
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int (*_done) (fdrelay &sender, int error);
+
+	/// @brief Constructor.
+	fdrelay() : dirs(), chunk(FDRELAY_CHUNK_SIZE), active(false), rcvr(0), _done(0) {}
+
+	/// @brief Destructor.
+	virtual ~fdrelay() {cleanup();}
+
+	/// @brief Initializes the relay and starts relaying.
+	///
+	/// Both epollers must be initialized. The relay becomes their receiver and their
+	/// auto enable/disable flags are cleared, as the relay controls events on its own.
+	///
+	/// @param a first epoller
+	/// @param b second epoller
+	/// @param chunk maximum number of bytes moved by one splice call
+	/// @param pipe_size size of intermediate pipes in bytes, zero means system default
+	/// @return @c true if initialization was successful, otherwise @c false
+	virtual bool init(fdepoller *a, fdepoller *b, size_t chunk = FDRELAY_CHUNK_SIZE, int pipe_size = 0);
+
+	/// @brief Cleanups the relay.
+	///
+	/// Intermediate pipes are closed (pending data are lost) and the relay stops to be receiver of the epollers.
+	virtual void cleanup();
+
+	/// @brief Called when relaying is finished.
+	///
+	/// Default implementation calls receiver::done method of #rcvr if not null,
+	/// otherwise calls #_done if not null,
+	/// otherwise returns -1.
+	///
+	/// @param error zero if both directions were finished normally, otherwise -1 and errno is set appropriately
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int done(int error);
+
+	/// @brief Handles events of relayed epollers.
+	/// @see fdepoller::receiver::enter
+	virtual int enter(fdepoller &sender, struct epoll_event *revent);
+
+	/// @brief Moves data from the source into the pipe and then flushes them to the sink.
+	///
+	/// Hung-up source is drained iteratively until it reaches end of file, it returns EAGAIN or the sink blocks.
+	///
+	/// @param dir direction
+	/// @return zero if relaying continues, positive if relaying is finished, negative if some error occurred
+	int pump(struct direction *dir);
+
+	/// @brief Moves data from the pipe to the sink and updates events of both epollers.
+	/// @param dir direction
+	/// @return zero if relaying continues, positive if relaying is finished, negative if some error occurred
+	int flush(struct direction *dir);
+
+	/// @brief Stops relaying by disabling both epollers.
+	void stop();
+};
+
+#endif // FDRELAY_H
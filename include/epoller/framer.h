@@ -0,0 +1,123 @@
+/// @file   epoller/framer.h
+/// @author speedak
+/// @brief  Frame splitter for received byte streams.
+
+#ifndef FRAMER_H
+#define FRAMER_H
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// @brief Default maximum frame size in bytes.
+#define FRAMER_MAX_SIZE 65536
+
+/// @brief Frame splitter.
+///
+/// Finds frames in a byte stream without copying them. The framer is attached to fdepoller by its fdepoller::frmr
+/// member, which then delivers whole frames (as views into fdepoller::rxbuff) instead of raw received data.
+///
+/// Supported frames are:
+///   - fixed-size frames,
+///   - length-prefixed frames (1, 2 or 4 bytes prefix of either endianness, or LEB128 varint prefix),
+///   - delimited frames.
+struct framer
+{
+	/// @brief Framing mode.
+	enum mode
+	{
+		FIXED,     ///< fixed-size frames
+		LENGTH,    ///< length-prefixed frames
+		DELIMITER  ///< delimited frames
+	};
+
+	enum mode   mode;       ///< framing mode
+	size_t      size;       ///< frame size (FIXED) or length prefix size in bytes: 1, 2, 4 or 0 for varint (LENGTH)
+	bool        big_endian; ///< length prefix is big endian (LENGTH, ignored for varint prefix)
+	bool        inclusive;  ///< length prefix includes its own size (LENGTH)
+	std::string delimiter;  ///< frame delimiter (DELIMITER)
+	bool        strip;      ///< delivered payload excludes length prefix or delimiter
+	size_t      max_size;   ///< maximum frame size including length prefix or delimiter
+	size_t      scan;       ///< number of bytes already scanned for delimiter (DELIMITER)
+	size_t      need;       ///< size of incomplete frame if already known, otherwise zero
+
+	std::vector<size_t> index;      ///< ends of delimited frames found by the last scan (DELIMITER)
+	size_t              index_pos;  ///< position of next frame in #index
+	size_t              index_base; ///< number of bytes consumed since the last scan
+
+	/// @brief Constructor.
+	framer() :
+	    mode       (FIXED          ),
+	    size       (1              ),
+	    big_endian (true           ),
+	    inclusive  (false          ),
+	    delimiter  (               ),
+	    strip      (true           ),
+	    max_size   (FRAMER_MAX_SIZE),
+	    scan       (0              ),
+	    need       (0              ),
+	    index      (               ),
+	    index_pos  (0              ),
+	    index_base (0              )
+	{}
+
+	/// @brief Initializes the framer for fixed-size frames.
+	/// @param size frame size in bytes (must not be zero)
+	void init_fixed(size_t size);
+
+	/// @brief Initializes the framer for length-prefixed frames.
+	/// @param prefix length prefix size in bytes: 1, 2, 4 or 0 for LEB128 varint prefix
+	/// @param big_endian if @c true the length prefix is big endian, otherwise little endian
+	/// @param inclusive if @c true the length prefix includes its own size
+	/// @param max_size maximum frame size including length prefix
+	/// @param strip if @c true the length prefix is excluded from delivered payload
+	void init_length(size_t prefix, bool big_endian = true, bool inclusive = false,
+	                 size_t max_size = FRAMER_MAX_SIZE, bool strip = true);
+
+	/// @brief Initializes the framer for delimited frames.
+	/// @param delimiter frame delimiter (must not be empty)
+	/// @param max_size maximum frame size including delimiter
+	/// @param strip if @c true the delimiter is excluded from delivered payload
+	void init_delimiter(const std::string &delimiter, size_t max_size = FRAMER_MAX_SIZE, bool strip = true);
+
+	/// @brief Resets state of incomplete frame and drops the frame index.
+	void reset() {scan = 0; need = 0; index.clear(); index_pos = 0; index_base = 0;}
+
+	/// @brief Gets number of whole frames, which have been already found, but not consumed yet.
+	///        It is valid only for delimited frames, zero is returned for other ones.
+	size_t frames() const {return index.size() - index_pos;}
+
+	/// @brief Appends positions of all occurrences of given byte to vector.
+	///        Vectorized (AVX2 or SSE2) implementation is chosen at runtime if supported by CPU.
+	/// @param data data
+	/// @param from position where to start
+	/// @param to position where to stop (exclusive)
+	/// @param byte byte to be found
+	/// @param pos vector of positions
+	static void find_all(const uint8_t *data, size_t from, size_t to, uint8_t byte, std::vector<size_t> &pos);
+
+	/// @brief Finds next frame.
+	///
+	/// The data must start at the beginning of a frame and they must contain the same bytes as at the previous call
+	/// (plus new ones) without the consumed frames, as the state of incomplete frame (#scan, #need) is kept.
+	/// The found frame is returned again until it is consumed by #consume.
+	///
+	/// Delimited frames are found in one pass over all not yet scanned bytes, their ends are stored to #index
+	/// and then they are returned one by one without any further scanning.
+	///
+	/// @param data received data
+	/// @param len length of received data
+	/// @param off offset of frame payload within data, set only if a frame is found
+	/// @param plen length of frame payload, set only if a frame is found
+	/// @return size of the found frame (>0), zero if the frame is incomplete,
+	///         -1 if the frame is malformed or it exceeds #max_size
+	ssize_t next(const uint8_t *data, size_t len, size_t *off, size_t *plen);
+
+	/// @brief Consumes the frame found by #next, so the following call of #next finds the frame after it.
+	///        It must be called when the frame is removed from the data.
+	/// @param flen size of the frame returned by #next
+	void consume(size_t flen);
+};
+
+#endif // FRAMER_H
@@ -7,19 +7,34 @@
 
 #include <epoller/epoller.h>
 #include <glib.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
 
-/// @brief Default number of processed glib file descriptors.
+/// @brief Default initial size of glib file descriptors array.
 #define GEPOLLER_GEVENTS_SIZE 32
 
+/// @brief Number of loop iterations, after which glib file descriptors array may shrink.
+#define GEPOLLER_SHRINK_PERIOD 1024
+
+/// @brief Period in milliseconds of full resynchronization of glib file descriptors with epoller.
+#define GEPOLLER_RESYNC_MSEC 1000
+
 /// @brief Glib file descriptor wrapper.
 ///        Only for internal usage.
+///
+/// One event is kept per distinct glib file descriptor. It stays registered in the epoller over loop iterations
+/// as long as glib polls the file descriptor.
 struct gepoller_event : epoller_event
 {
-	struct epoll_event  event; ///< epoll event
-	GPollFD            *gfd;   ///< glib file descriptor
+	struct epoll_event  event;   ///< epoll event
+	int                 fd;      ///< glib file descriptor, -1 if the slot is free
+	int                 events;  ///< glib events requested in the current loop iteration
+	int                 revents; ///< glib events returned in the current loop iteration
+	unsigned long       gen;     ///< loop iteration, in which the file descriptor was polled by glib for the last time
 
 	/// @brief Constructor.
-	gepoller_event() : event(), gfd(0) {}
+	gepoller_event() : event(), fd(-1), events(0), revents(0), gen(0) {}
 
 	/// @brief Destructor.
 	virtual ~gepoller_event() {}
@@ -28,11 +43,14 @@ struct gepoller_event : epoller_event
 	virtual int handler(struct epoller *epoller, struct epoll_event *revent);
 
 	/// @brief Adds file descriptor of this event to given epoller.
-	///        #gfd member must be initialized
+	///        #fd and #events members must be initialized
 	bool add_to_epoller(struct epoller *epoller);
 
+	/// @brief Modifies events of file descriptor of this event in given epoller according to #events member.
+	bool mod_in_epoller(struct epoller *epoller);
+
 	/// @brief Deletes file descriptor of this event from given epoller.
-	///        #gfd member must be initialized
+	///        #fd member must be initialized
 	bool del_from_epoller(struct epoller *epoller);
 
 	/// @brief Converts event flags from glib to linux epoll.
@@ -45,31 +63,46 @@ struct gepoller_event : epoller_event
 /// @brief Epoll wrapper with glib main context processing support.
 struct gepoller : epoller
 {
-	size_t          gevents_size; ///< size of gepoller events (and also glib file descriptors) array
-	gepoller_event *gevents;      ///< gepoller events
-	GPollFD        *gfds;         ///< glib file descriptors
-	GMainContext   *context;      ///< glib main context
+	size_t                                   gevents_size; ///< size of glib file descriptors array
+	size_t                                   gevents_min;  ///< minimum size of glib file descriptors array
+	GPollFD                                 *gfds;         ///< glib file descriptors
+	GMainContext                            *context;      ///< glib main context
+	std::unordered_map<int, gepoller_event*> gslots;       ///< glib file descriptor to gepoller event map
+	std::vector<gepoller_event*>             gfree;        ///< pool of free gepoller events
+	unsigned long                            ggen;         ///< loop iteration counter
+	int                                      gpeak;        ///< peak number of glib file descriptors within shrink period
+	uint64_t                                 gsync;        ///< time of the last full resynchronization in milliseconds (CLOCK_MONOTONIC)
 
 	/// @brief Constructor.
 	gepoller() :
-	    epoller     (                                ),
-	    gevents_size(GEPOLLER_GEVENTS_SIZE           ),
-	    gevents     (new gepoller_event[gevents_size]),
-	    gfds        (new GPollFD[gevents_size]       ),
-	    context     (0                               )
+	    epoller     (                        ),
+	    gevents_size(GEPOLLER_GEVENTS_SIZE   ),
+	    gevents_min (GEPOLLER_GEVENTS_SIZE   ),
+	    gfds        (new GPollFD[gevents_size]),
+	    context     (0                       ),
+	    gslots      (                        ),
+	    gfree       (                        ),
+	    ggen        (0                       ),
+	    gpeak       (0                       ),
+	    gsync       (0                       )
 	{
 		set_context(g_main_context_default());
 	}
 
 	/// @brief Constructor.
 	/// @param revents_size maximum number of events returned from epoll_wait.
-	/// @param gevents_size maximum number of processed glib file descriptors.
+	/// @param gevents_size initial (and minimum) size of glib file descriptors array, it grows on demand.
 	gepoller(size_t revents_size, size_t gevents_size) :
-	    epoller     (revents_size                    ),
-	    gevents_size(gevents_size                    ),
-	    gevents     (new gepoller_event[gevents_size]),
-	    gfds        (new GPollFD[gevents_size]       ),
-	    context     (0                               )
+	    epoller     (revents_size                      ),
+	    gevents_size(gevents_size ? gevents_size : 1   ),
+	    gevents_min (this->gevents_size                ),
+	    gfds        (new GPollFD[this->gevents_size]   ),
+	    context     (0                                 ),
+	    gslots      (                                  ),
+	    gfree       (                                  ),
+	    ggen        (0                                 ),
+	    gpeak       (0                                 ),
+	    gsync       (0                                 )
 	{
 		set_context(g_main_context_default());
 	}
@@ -77,7 +110,9 @@ struct gepoller : epoller
 	/// @brief Destructor.
 	virtual ~gepoller() {
 		set_context(0);
-		delete [] gevents;
+		clear_gevents();
+		for (size_t i = 0; i < gfree.size(); ++i)
+			delete gfree[i];
 		delete [] gfds;
 	}
 
@@ -88,13 +123,51 @@ struct gepoller : epoller
 	///        May be called only before loop is called.
 	void set_context(GMainContext *context);
 
-	/// @brief Adds glib file descriptors to epoller.
+	/// @brief Queries glib file descriptors to #gfds, the array grows if it is too small.
+	///        Only for internal usage.
+	/// @param g_priority priority returned from g_main_context_prepare
+	/// @param g_timeout returned glib timeout
+	/// @return number of glib file descriptors stored in #gfds
+	int query_gfds(int g_priority, int *g_timeout);
+
+	/// @brief Shrinks #gfds array and pool of free gepoller events, if the number of glib file descriptors has been
+	///        lower than quarter of #gevents_size for the whole period of #GEPOLLER_SHRINK_PERIOD loop iterations.
+	///        Only for internal usage.
+	/// @param gfds_n number of glib file descriptors in the current loop iteration
+	void shrink_gfds(int gfds_n);
+
+	/// @brief Synchronizes glib file descriptors registered in epoller with those returned by glib.
+	///
+	/// Only differences against the previous loop iteration are applied: new file descriptors are added,
+	/// the ones with changed events are modified and the ones not polled any more are deleted.
+	/// Glib may poll one file descriptor more times (with different events), such file descriptor is registered
+	/// once with union of the events.
+	///
+	/// A file descriptor closed and reopened under the same number between two loop iterations with unchanged
+	/// events cannot be told apart, but epoll drops closed file descriptors silently. Therefore all file
+	/// descriptors are re-registered every #GEPOLLER_RESYNC_MSEC milliseconds (see #resync_timeout), so such
+	/// file descriptor is polled again within that period at the latest.
+	///
+	/// Only for internal usage.
+	///
+	/// @param gfds_n number of glib file descriptors in #gfds
+	/// @return @c true if synchronization was successful, otherwise @c false
+	bool sync_gevents(int gfds_n);
+
+	/// @brief Gets time remaining to the next full resynchronization of glib file descriptors.
+	///        Only for internal usage.
+	/// @return timeout in milliseconds for epoll_wait, -1 if no glib file descriptor is registered
+	int resync_timeout();
+
+	/// @brief Copies returned events to glib file descriptors.
 	///        Only for internal usage.
-	bool add_gevents_to_epoller(int gfds_n);
+	/// @param gfds_n number of glib file descriptors in #gfds
+	void collect_gevents(int gfds_n);
 
-	/// @brief Deletes glib file descriptors from epoller.
+	/// @brief Deletes all glib file descriptors from epoller.
 	///        Only for internal usage.
-	bool del_gevents_from_epoller(int gfds_n);
+	/// @return @c true if deletion was successful, otherwise @c false
+	bool clear_gevents();
 };
 
 #endif // GEPOLLER_H
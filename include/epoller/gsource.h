@@ -0,0 +1,52 @@
+/// @file   epoller/gsource.h
+/// @author speedak
+/// @brief  Glib source driving epoller from glib main loop.
+
+#ifndef GSOURCE_H
+#define GSOURCE_H
+
+#include <epoller/epoller.h>
+#include <glib.h>
+
+/// @brief Glib source driving epoller.
+///
+/// It is the reverse of gepoller: the epoller is run by an existing glib main loop (e.g. GTK or GStreamer
+/// application), which polls just the epoll file descriptor of the epoller. When it becomes readable, epoll_wait
+/// is called with zero timeout and the returned events are dispatched to their handlers (see epoller::dispatch).
+///
+/// Epoller's handlers are called as within epoller::loop with these exceptions:
+///   - pre_epoll_handler and flushing of events are called from the prepare function of the source,
+///   - post_epoll_handler is called from the dispatch function of the source,
+///   - timeout_handler is never called (glib timeouts should be used instead), epoller::timeout only limits
+///     the glib poll timeout.
+///
+/// When some handler announces loop exit, epoller::loop_exit is set and the source is destroyed.
+struct epoller_gsource
+{
+	GSource         source;  ///< glib source (must be the first member)
+	struct epoller *epoller; ///< driven epoller
+	gpointer        tag;     ///< tag of polled epoll file descriptor
+	bool            ready;   ///< some reception has been deferred, so the source must be dispatched without polling
+
+	/// @brief Creates glib source driving given epoller.
+	/// @param epoller initialized epoller
+	/// @return new glib source (with reference count of one) or null if the epoller is not initialized
+	static GSource *create(struct epoller *epoller);
+
+	/// @brief Creates glib source driving given epoller and attaches it to given context.
+	/// @param epoller initialized epoller
+	/// @param context glib main context, null for the default one
+	/// @return source id (greater than zero) or zero if the epoller is not initialized
+	static guint attach(struct epoller *epoller, GMainContext *context = 0);
+
+	/// @brief Prepare function of the source.
+	static gboolean prepare(GSource *source, gint *timeout);
+
+	/// @brief Check function of the source.
+	static gboolean check(GSource *source);
+
+	/// @brief Dispatch function of the source.
+	static gboolean dispatch(GSource *source, GSourceFunc callback, gpointer user_data);
+};
+
+#endif // GSOURCE_H
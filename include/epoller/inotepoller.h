@@ -6,12 +6,27 @@
 #define INOTEPOLLER_H
 
 #include <epoller/epoller.h>
+#include <epoller/timepoller.h>
 #include <sys/inotify.h>
 #include <stdint.h>
+#include <time.h>
 #include <string>
+#include <vector>
+#include <list>
+#include <map>
+
+/// @brief Default size of buffer for read events.
+#define INOTEPOLLER_BUFF_SIZE 65536
 
 /// @brief Inotify epoller.
-struct inotepoller : epoller_event
+///
+/// All events queued in the inotify file descriptor are read at once (as many as fit into #buff) and dispatched
+/// one by one, so a burst of events costs a few syscalls only. If a callback returns nonzero, events not dispatched
+/// yet are kept in #buff and they are dispatched before the next read (just before next epoll_wait at the latest).
+///
+/// Optionally the events may be coalesced (see #coalesce): events of the same watch and name are merged
+/// until the name is quiet for given time window and then one event with all the masks or-ed is delivered.
+struct inotepoller : epoller_event, timepoller::receiver
 {
 	/// @brief Event receiver interface.
 	struct receiver
@@ -25,12 +40,45 @@ struct inotepoller : epoller_event
 		/// @param event structure with information about the occurred event
 		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
 		virtual int inothandler(inotepoller &sender, struct inotify_event *event);
+
+		/// @brief Called when event queue has overflowed (IN_Q_OVERFLOW), so some events have been lost.
+		///        Default implementation calls inothandler.
+		/// @param sender event sender
+		/// @param event structure with information about the occurred event (wd is -1)
+		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+		virtual int overflow(inotepoller &sender, struct inotify_event *event);
+	};
+
+	/// @brief Coalesced event waiting for the end of quiet window.
+	struct coalesced
+	{
+		int             wd;   ///< watch descriptor
+		uint32_t        mask; ///< or-ed masks of merged events
+		std::string     name; ///< name
+		struct timespec last; ///< time of the last merged event (CLOCK_MONOTONIC)
 	};
 
-	int                fd;      ///< inotify file descriptor
-	struct epoller    *epoller; ///< parent epoller
-	struct epoll_event event;   ///< epoll event
-	struct receiver   *rcvr;    ///< event receiver
+	/// @brief Key of coalesced event (watch descriptor and name).
+	typedef std::pair<int, std::string> coalesced_key;
+
+	/// @brief List of coalesced events.
+	typedef std::list<struct coalesced> coalesced_list;
+
+	int                                               fd;             ///< inotify file descriptor
+	struct epoller                                   *epoller;        ///< parent epoller
+	struct epoll_event                                event;          ///< epoll event
+	struct receiver                                  *rcvr;           ///< event receiver
+	std::vector<uint8_t>                              buff;           ///< buffer for read events
+	size_t                                            buff_pos;       ///< offset of the first read event not dispatched yet
+	size_t                                            buff_len;       ///< length of read events in #buff
+	bool                                              queued;         ///< added to flush list of parent epoller (see #flush)
+	unsigned long                                     overflow_cnt;   ///< IN_Q_OVERFLOW counter
+	unsigned int                                      coalesce_msec;  ///< quiet window in milliseconds, zero if coalescing is disabled
+	unsigned long                                     coalesced_cnt;  ///< number of events merged into pending ones (suppressed)
+	timepoller                                        coalesce_timer; ///< timer delivering coalesced events
+	bool                                              coalesce_armed; ///< #coalesce_timer is armed
+	coalesced_list                                    pending;        ///< coalesced events ordered by time of the last merged event
+	std::map<coalesced_key, coalesced_list::iterator> pending_keys;   ///< coalesced events by keys
 
 	/// @brief Called when event occurs.
 	/// @param sender event sender
@@ -38,9 +86,33 @@ struct inotepoller : epoller_event
 	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
 	int (*_inothandler) (inotepoller &sender, struct inotify_event *event);
 
+	/// @brief Called when event queue has overflowed (IN_Q_OVERFLOW), so some events have been lost.
+	/// @param sender event sender
+	/// @param event structure with information about the occurred event (wd is -1)
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int (*_overflow) (inotepoller &sender, struct inotify_event *event);
+
 	/// @brief Constructor.
 	/// @param epoller parent epoller
-	inotepoller(struct epoller *epoller) : fd(-1), epoller(epoller), event(), rcvr(0), _inothandler(0) {}
+	inotepoller(struct epoller *epoller) :
+	    fd             (-1     ),
+	    epoller        (epoller),
+	    event          (       ),
+	    rcvr           (0      ),
+	    buff           (       ),
+	    buff_pos       (0      ),
+	    buff_len       (0      ),
+	    queued         (false  ),
+	    overflow_cnt   (0      ),
+	    coalesce_msec  (0      ),
+	    coalesced_cnt  (0      ),
+	    coalesce_timer (epoller),
+	    coalesce_armed (false  ),
+	    pending        (       ),
+	    pending_keys   (       ),
+	    _inothandler   (0      ),
+	    _overflow      (0      )
+	{}
 
 	/// @brief Default constructor.
 	inotepoller() : inotepoller(0) {}
@@ -49,12 +121,25 @@ struct inotepoller : epoller_event
 	virtual ~inotepoller() {cleanup();}
 
 	/// @brief Initializes the inotify epoller.
+	/// @param buffsize size of buffer for read events in bytes (enlarged to fit at least one event with the longest name)
 	/// @return @c true if initialization was successful, otherwise @c false
-	virtual bool init();
+	virtual bool init(size_t buffsize = INOTEPOLLER_BUFF_SIZE);
 
-	/// @brief Cleanups the inotify epoller.
+	/// @brief Cleanups the inotify epoller, coalescing is disabled and pending coalesced events are dropped.
 	virtual void cleanup();
 
+	/// @brief Enables or disables coalescing of events.
+	///
+	/// Events of the same watch descriptor and name are merged until no other one comes within the quiet window,
+	/// then single event with or-ed masks is delivered by inothandler. Events with cookie (IN_MOVED_FROM, IN_MOVED_TO),
+	/// IN_IGNORED, IN_UNMOUNT and IN_Q_OVERFLOW are delivered immediately, pending events of the same name (or watch
+	/// descriptor) are delivered before them, so order per name is kept.
+	///
+	/// @param msec quiet window in milliseconds, zero disables coalescing (pending events are delivered
+	///             within the next loop iteration)
+	/// @return @c true if setting was successful, otherwise @c false
+	bool coalesce(unsigned int msec);
+
 	/// @brief Adds watch.
 	/// @param pathname watched pathname
 	/// @param mask mask with monitoring events (IN_OPEN, IN_MODIFY, IN_CLOSE_WRITE, ...)
@@ -69,6 +154,33 @@ struct inotepoller : epoller_event
 	/// @copydoc epoller_event::handler
 	virtual int handler(struct epoller *epoller, struct epoll_event *revent);
 
+	/// @brief Dispatches read events left undispatched by previous callback returning nonzero.
+	/// @copydoc epoller_event::flush
+	virtual int flush(struct epoller *epoller, int *timeout);
+
+	/// @brief Dispatches read events not dispatched yet.
+	///        If a callback returns nonzero, the rest is queued to be flushed.
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int dispatch();
+
+	/// @brief Delivers the event by inothandler or merges it into pending coalesced one.
+	/// @param event structure with information about the occurred event
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int coalesce_event(struct inotify_event *event);
+
+	/// @brief Delivers pending coalesced events by inothandler.
+	/// @param pthis pointer to this pointer of the event being handled (see epoller_event::pthis), delivering stops
+	///              when it is nulled
+	/// @param all if @c true all events are delivered, otherwise only those quiet for the whole window
+	/// @param wd if nonnegative only events of the watch descriptor are delivered (regardless of window)
+	/// @param name if not null only event of the watch descriptor and the name is delivered (regardless of window)
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int flush_coalesced(struct epoller_event **pthis, bool all, int wd = -1, const char *name = 0);
+
+	/// @brief Delivers coalesced events quiet for the whole window.
+	/// @copydoc timepoller::receiver::timerhandler
+	virtual int timerhandler(timepoller &sender, uint64_t exp);
+
 	/// @brief Called when event occurs.
 	///
 	/// Default implementation calls receiver::inothandler method of #rcvr if not null,
@@ -78,6 +190,16 @@ struct inotepoller : epoller_event
 	/// @param event structure with information about the occurred event
 	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
 	virtual int inothandler(struct inotify_event *event);
+
+	/// @brief Called when event queue has overflowed (IN_Q_OVERFLOW), so some events have been lost.
+	///
+	/// Default implementation calls receiver::overflow method of #rcvr if not null,
+	/// otherwise calls #_overflow if not null,
+	/// otherwise calls inothandler.
+	///
+	/// @param event structure with information about the occurred event (wd is -1)
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int overflow(struct inotify_event *event);
 };
 
 #endif // INOTEPOLLER_H
@@ -32,9 +32,11 @@ struct jsepoller : fdepoller
 	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
 	int (*_jshandler) (jsepoller &sender, struct js_event *event);
 
+	struct framer jsframer; ///< framer splitting received data into joystick events
+
 	/// @brief Constructor.
 	/// @param epoller parent epoller
-	jsepoller(struct epoller *epoller) : fdepoller(epoller) {}
+	jsepoller(struct epoller *epoller) : fdepoller(epoller), _jshandler(0), jsframer() {}
 
 	/// @brief Default constructor.
 	jsepoller() : jsepoller(0) {}
@@ -73,6 +75,10 @@ struct jsepoller : fdepoller
 	/// @copydoc fdepoller::rx
 	virtual int rx(int len);
 
+	/// @brief Calls jshandler for received joystick event.
+	/// @copydoc fdepoller::frame
+	virtual int frame(const uint8_t *data, size_t len);
+
 	/// @brief Called when joystick event is received.
 	///
 	/// Default implementation calls receiver::jshandler method of #rcvr if not null,
@@ -0,0 +1,124 @@
+/// @file   epoller/log.h
+/// @author speedak
+/// @brief  Logging backend with severity levels, rate limiting and asynchronous output.
+
+#ifndef EPOLLER_LOG_H
+#define EPOLLER_LOG_H
+
+#include <cstddef>
+#include <atomic>
+#include <errno.h>
+#include <stdint.h>
+
+/// @brief Maximum length of one log message including terminating null character (longer ones are truncated).
+#define ELOG_MSG_SIZE 256
+
+/// @brief Default number of messages in asynchronous ring.
+#define ELOG_RING_SIZE 4096
+
+/// @brief Log message severity.
+enum elog_level
+{
+	ELOG_ERROR,   ///< error
+	ELOG_WARNING, ///< warning
+	ELOG_INFO,    ///< informational message
+	ELOG_DEBUG    ///< debug message
+};
+
+/// @brief Log sink, receives formatted messages.
+///
+/// In asynchronous mode the sink is called from the drain thread only, otherwise it is called directly from
+/// the thread which logs the message (possibly from more threads at once).
+struct elog_sink
+{
+	/// @brief Destructor.
+	virtual ~elog_sink() {}
+
+	/// @brief Writes message.
+	/// @param level message severity
+	/// @param msg null terminated message (without trailing new line)
+	/// @param len length of message
+	virtual void write(enum elog_level level, const char *msg, size_t len) = 0;
+};
+
+/// @brief Log sink writing to standard error output (the default one).
+struct elog_stderr_sink : elog_sink
+{
+	/// @copydoc elog_sink::write
+	virtual void write(enum elog_level level, const char *msg, size_t len);
+};
+
+/// @brief State of one logging call site, used for rate limiting.
+struct elog_site
+{
+	std::atomic<uint64_t>     window;     ///< start of the current rate limiting window in milliseconds
+	std::atomic<unsigned int> count;      ///< number of messages within the current window
+	std::atomic<unsigned int> suppressed; ///< number of suppressed messages not reported yet
+
+	/// @brief Constructor.
+	elog_site() : window(0), count(0), suppressed(0) {}
+};
+
+/// @brief Current severity threshold, messages with higher level are discarded before they are formatted.
+extern std::atomic<int> elog_threshold;
+
+/// @brief Sets severity threshold (ELOG_INFO by default).
+/// @param level the least severe level which is still logged
+void elog_set_level(enum elog_level level);
+
+/// @brief Sets log sink.
+/// @param sink log sink (must exist until it is replaced), zero for the default standard error sink
+void elog_set_sink(struct elog_sink *sink);
+
+/// @brief Sets per call site rate limiting (disabled by default).
+///
+/// Every call site may log at most @p burst messages within @p interval_ms milliseconds, the rest is suppressed.
+/// Number of suppressed messages is appended to the next message logged from the site.
+///
+/// @param burst maximum number of messages within interval, zero disables rate limiting
+/// @param interval_ms interval in milliseconds
+void elog_set_rate_limit(unsigned int burst, unsigned int interval_ms = 1000);
+
+/// @brief Switches to asynchronous mode.
+///
+/// Messages are then formatted by the logging thread into a lock-free ring and written to the sink by a background
+/// drain thread. When the ring is full the message is dropped (see elog_dropped).
+///
+/// @param size number of messages in ring (rounded up to power of two)
+/// @return @c true if the drain thread has been started, otherwise @c false
+bool elog_async_start(size_t size = ELOG_RING_SIZE);
+
+/// @brief Switches back to synchronous mode, all messages in ring are written before it returns.
+///        Like elog_async_start it must not be called while other threads may log.
+void elog_async_stop();
+
+/// @brief Gets number of messages dropped due to full asynchronous ring.
+unsigned long elog_dropped();
+
+/// @brief Logs message.
+/// @param level message severity
+/// @param site call site state, may be zero (no rate limiting)
+/// @param errnum if non-negative, ": " and description of the error number is appended (as perror does)
+/// @param fmt printf-like format
+void elog(enum elog_level level, struct elog_site *site, int errnum, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+/// @brief Logs message with rate limiting by call site.
+#define ELOG(level, ...) \
+	do { \
+		static struct elog_site elog_site_; \
+		if ((level) <= elog_threshold.load(std::memory_order_relaxed)) \
+			elog(level, &elog_site_, -1, __VA_ARGS__); \
+	} while (0)
+
+/// @brief Logs message with description of errno appended (replacement for perror).
+#define ELOG_ERRNO(level, ...) \
+	do { \
+		static struct elog_site elog_site_; \
+		int elog_errno_ = errno; \
+		if ((level) <= elog_threshold.load(std::memory_order_relaxed)) \
+			elog(level, &elog_site_, elog_errno_, __VA_ARGS__); \
+		errno = elog_errno_; \
+	} while (0)
+
+#endif // EPOLLER_LOG_H
@@ -0,0 +1,150 @@
+/// @file   epoller/migrator.h
+/// @author speedak
+/// @brief  Migration of events between epollers running in different threads.
+
+#ifndef MIGRATOR_H
+#define MIGRATOR_H
+
+#include <epoller/epoller.h>
+#include <epoller/evepoller.h>
+#include <epoller/timepoller.h>
+#include <atomic>
+#include <vector>
+#include <time.h>
+
+struct balancer;
+
+/// @brief Event migrator.
+///
+/// Every epoller, which takes part in migration, has its own migrator. An event (typically fdepoller) is detached
+/// from the epoller of the source migrator (see epoller_event::detach) in the source thread, handed over through
+/// the lock-free stack #incoming of the target migrator and attached to the epoller of the target migrator
+/// (see epoller_event::attach) in the target thread, which is woken up by #wakeup event.
+///
+/// Events adopted by the migrator (see #adopt) are candidates for automatic migration done by #blncr.
+struct migrator : evepoller::receiver, timepoller::receiver
+{
+	/// @brief Event receiver interface.
+	struct receiver
+	{
+		/// @brief Destructor.
+		virtual ~receiver() {}
+
+		/// @brief Called when migrated event has been attached to the epoller of the migrator
+		///        or when attaching failed (the event stays detached then).
+		///        Default implementation returns 0.
+		/// @param sender event sender
+		/// @param ev migrated event
+		/// @param attached @c true if the event has been attached successfully
+		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+		virtual int migrated(migrator &sender, struct epoller_event *ev, bool attached);
+	};
+
+	/// @brief Node of #incoming stack.
+	struct node
+	{
+		struct epoller_event *ev;     ///< migrated event
+		bool                  member; ///< the event has been adopted by the source migrator
+		struct node          *next;   ///< next node
+	};
+
+	struct epoller                    *epoller;   ///< parent epoller
+	evepoller                          wakeup;    ///< wakes up the parent epoller when some events are incoming
+	timepoller                         ticker;    ///< samples load of the parent epoller (see #balance)
+	std::atomic<struct node*>          incoming;  ///< stack of incoming events
+	std::vector<struct epoller_event*> members;   ///< adopted events, candidates for balancing
+	struct receiver                   *rcvr;      ///< event receiver
+	struct balancer                   *blncr;     ///< balancer, zero if not balanced
+	std::atomic<double>                load;      ///< load of the parent epoller measured in the last period
+	unsigned long                      sent_cnt;  ///< number of events migrated from the parent epoller
+	unsigned long                      recv_cnt;  ///< number of events migrated to the parent epoller
+	struct timespec                    last_time; ///< time of the last load sample (CLOCK_MONOTONIC)
+	struct timespec                    last_cpu;  ///< CPU time of the thread at the last load sample
+	unsigned long                      last_cnt;  ///< epoller::handled_cnt at the last load sample
+
+	/// @brief Called when migrated event has been attached to the epoller of the migrator
+	///        or when attaching failed (the event stays detached then).
+	/// @param sender event sender
+	/// @param ev migrated event
+	/// @param attached @c true if the event has been attached successfully
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int (*_migrated) (migrator &sender, struct epoller_event *ev, bool attached);
+
+	/// @brief Constructor.
+	/// @param epoller parent epoller
+	migrator(struct epoller *epoller) :
+	    epoller   (epoller),
+	    wakeup    (epoller),
+	    ticker    (epoller),
+	    incoming  (0      ),
+	    members   (       ),
+	    rcvr      (0      ),
+	    blncr     (0      ),
+	    load      (0      ),
+	    sent_cnt  (0      ),
+	    recv_cnt  (0      ),
+	    last_time (       ),
+	    last_cpu  (       ),
+	    last_cnt  (0      ),
+	    _migrated (0      )
+	{}
+
+	/// @brief Destructor.
+	virtual ~migrator() {cleanup();}
+
+	/// @brief Initializes the migrator.
+	/// @return @c true if initialization was successful, otherwise @c false
+	virtual bool init();
+
+	/// @brief Cleanups the migrator.
+	///        Events, which are still incoming, are dropped (they stay detached).
+	virtual void cleanup();
+
+	/// @brief Migrates event to the epoller of another migrator.
+	///
+	/// It must be called from the thread running the parent epoller. The event must not be touched after
+	/// successful return, as it belongs to the target thread. If the event has been adopted, the target
+	/// migrator adopts it.
+	///
+	/// @param ev event attached to the parent epoller
+	/// @param target target migrator
+	/// @return @c true if the event has been handed over, otherwise @c false
+	bool migrate(struct epoller_event *ev, migrator &target);
+
+	/// @brief Adopts the event, so it may be migrated by the balancer.
+	/// @param ev event attached to the parent epoller
+	void adopt(struct epoller_event *ev) {members.push_back(ev);}
+
+	/// @brief Forgets adopted event (e.g. before it is destroyed).
+	/// @param ev adopted event
+	/// @return @c true if the event was adopted, otherwise @c false
+	bool forget(struct epoller_event *ev);
+
+	/// @brief Starts sampling load of the parent epoller and balancing.
+	/// @param blncr balancer (the migrator is added to it)
+	/// @param msec sampling period in milliseconds
+	/// @return @c true if balancing has been started, otherwise @c false
+	bool balance(struct balancer *blncr, uint64_t msec = 1000);
+
+	/// @brief Attaches incoming events.
+	/// @copydoc evepoller::receiver::recv_handler
+	virtual int recv_handler(evepoller &sender, uint64_t cnt);
+
+	/// @brief Samples load and lets the balancer migrate events.
+	/// @copydoc timepoller::receiver::timerhandler
+	virtual int timerhandler(timepoller &sender, uint64_t exp);
+
+	/// @brief Called when migrated event has been attached to the epoller of the migrator
+	///        or when attaching failed (the event stays detached then).
+	///
+	/// Default implementation calls receiver::migrated method of #rcvr if not null,
+	/// otherwise calls #_migrated if not null,
+	/// otherwise returns 0.
+	///
+	/// @param ev migrated event
+	/// @param attached @c true if the event has been attached successfully
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int migrated(struct epoller_event *ev, bool attached);
+};
+
+#endif // MIGRATOR_H
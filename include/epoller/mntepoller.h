@@ -7,7 +7,10 @@
 
 #include <paths.h>
 #include <epoller/fdepoller.h>
+#include <stdint.h>
 #include <list>
+#include <vector>
+#include <utility>
 #include <iostream>
 
 /// @brief Mount file entry. The members correspond with those
@@ -22,8 +25,26 @@ struct mntentry
 	int         passno;   ///< pass number on parallel fsck
 };
 
+/// @brief Differences between two reads of mount file.
+struct mntdiff
+{
+	std::vector<mntentry>                        added;   ///< new entries
+	std::vector<mntentry>                        removed; ///< disappeared entries
+	std::vector<std::pair<mntentry, mntentry> >  changed; ///< changed entries (old and new one) with the same dir
+
+	/// @brief Checks whether there are no differences.
+	bool empty() const {return added.empty() && removed.empty() && changed.empty();}
+
+	/// @brief Clears the differences (keeping allocated capacity).
+	void clear() {added.clear(); removed.clear(); changed.clear();}
+};
+
 /// @brief Mount epoller. It waits for any change of mount file (typically @c /etc/mtab)
 ///        and when the change occurs appropriate callback is called.
+///
+/// In incremental mode (see #incremental) the previous content of the mount file is kept and only differences
+/// are delivered by #changes. The content is parsed in place (fields are just offsets into the copy of the file)
+/// and indexed by mount dir in open addressing hash table, so no allocation is done unless something has changed.
 struct mntepoller : fdepoller
 {
 	/// @brief Event receiver interface.
@@ -38,17 +59,73 @@ struct mntepoller : fdepoller
 		/// @param entries mount entries
 		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
 		virtual int change(mntepoller &sender, const std::list<mntentry> &entries);
+
+		/// @brief Called whenever mount entries have changed (in incremental mode).
+		///        The first call delivers all entries as added.
+		///        Default implementation returns -1.
+		/// @param sender event sender
+		/// @param diff differences from the previous call
+		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+		virtual int changes(mntepoller &sender, const mntdiff &diff);
+	};
+
+	/// @brief Field of mount entry within snapshot.
+	struct field
+	{
+		uint32_t off; ///< offset in snapshot data
+		uint32_t len; ///< length
 	};
 
+	/// @brief Mount entry within snapshot.
+	struct line
+	{
+		struct field all;     ///< whole line
+		struct field fsname;  ///< name of mounted filesystem
+		struct field dir;     ///< filesystem path prefix
+		struct field type;    ///< mount type
+		struct field opts;    ///< mount options
+		int          freq;    ///< dump frequency in days
+		int          passno;  ///< pass number on parallel fsck
+		int          next;    ///< index of next line with the same dir, -1 if none
+		bool         matched; ///< matched by line of the other snapshot
+	};
+
+	/// @brief Parsed content of mount file.
+	struct snapshot
+	{
+		std::string       data;  ///< content of mount file
+		std::vector<line> lines; ///< parsed lines
+		std::vector<int>  index; ///< open addressing hash table of the first lines by dir (-1 for empty slot)
+	};
+
+	bool            incremental; ///< deliver differences by #changes instead of all entries by #change
+	struct snapshot snaps[2];    ///< current and previous snapshot
+	int             snap;        ///< index of current snapshot
+	mntdiff         diff;        ///< differences delivered by #changes
+
 	/// @brief Called whenever mount entries have changed.
 	/// @param sender event sender
 	/// @param entries mount entries
 	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
 	int (*_change) (mntepoller &sender, const std::list<mntentry> &entries);
 
+	/// @brief Called whenever mount entries have changed (in incremental mode).
+	/// @param sender event sender
+	/// @param diff differences from the previous call
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int (*_changes) (mntepoller &sender, const mntdiff &diff);
+
 	/// @brief Constructor.
 	/// @param epoller parent epoller
-	mntepoller(struct epoller *epoller) : fdepoller(epoller), _change(0) {
+	mntepoller(struct epoller *epoller) :
+	    fdepoller   (epoller),
+	    incremental (false  ),
+	    snaps       (       ),
+	    snap        (0      ),
+	    diff        (       ),
+	    _change     (0      ),
+	    _changes    (0      )
+	{
 		rx_auto_enable  = false;
 		rx_auto_disable = false;
 		tx_auto_enable  = false;
@@ -91,6 +168,30 @@ struct mntepoller : fdepoller
 	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
 	virtual int change(const std::list<mntentry> &entries);
 
+	/// @brief This handler is called whenever mount entries have changed (in incremental mode).
+	///
+	/// Default implementation calls receiver::changes method of #rcvr if not null,
+	/// otherwise calls #_changes if not null,
+	/// otherwise returns -1.
+	///
+	/// @param diff differences from the previous call
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int changes(const mntdiff &diff);
+
+	/// @brief Parses content of mount file and indexes it by dir.
+	/// @param snap snapshot with data to be parsed
+	static void parse(struct snapshot &snap);
+
+	/// @brief Finds the first line with given dir.
+	/// @param snap snapshot to be searched
+	/// @param dir dir to find
+	/// @param len length of dir
+	/// @return index of the line, -1 if not found
+	static int lookup(const struct snapshot &snap, const char *dir, size_t len);
+
+	/// @brief Converts line of snapshot to mount entry.
+	static void to_entry(const struct snapshot &snap, const struct line &l, mntentry &entry);
+
 	/// @brief Reads mount file.
 	/// @param entries returned mount entries
 	/// @param pathname mount file
@@ -0,0 +1,134 @@
+/// @file   epoller/procepoller.h
+/// @author speedak
+/// @brief  Child process wrapper based on process file descriptor.
+
+#ifndef PROCEPOLLER_H
+#define PROCEPOLLER_H
+
+#include <epoller/epoller.h>
+#include <epoller/fdepoller.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+
+/// @brief Flag for procepoller::spawn, the child's stdin is connected to #procepoller::in_pipe.
+#define PROCEPOLLER_STDIN  0x01
+
+/// @brief Flag for procepoller::spawn, the child's stdout is connected to #procepoller::out_pipe.
+#define PROCEPOLLER_STDOUT 0x02
+
+/// @brief Flag for procepoller::spawn, the child's stderr is connected to #procepoller::err_pipe.
+#define PROCEPOLLER_STDERR 0x04
+
+/// @brief Child process epoller.
+///
+/// The child is spawned by clone with CLONE_PIDFD (by posix_spawn and pidfd_open on older kernels) and watched
+/// through its process file descriptor (pidfd), which becomes readable when the child exits. The child is reaped
+/// by waitid(P_PIDFD), so no SIGCHLD handling nor waitpid loop is needed and other SIGCHLD consumers are not raced.
+/// If the child is reaped by someone else anyway (by waitpid(-1)), #exited is called with unknown exit status.
+///
+/// Standard streams of the child may be connected to pipes wrapped by #in_pipe, #out_pipe and #err_pipe
+/// (non-blocking parent ends), which are regular file descriptor epollers with their own receivers.
+/// Data written by the child may still be pending in #out_pipe and #err_pipe when #exited is called,
+/// the end of data is announced by hang-out event of the pipe.
+struct procepoller : epoller_event
+{
+	/// @brief Event receiver interface.
+	struct receiver
+	{
+		/// @brief Destructor.
+		virtual ~receiver() {}
+
+		/// @brief Called when the child has exited (and it has been reaped).
+		///        Default implementation returns -1.
+		/// @param sender event sender
+		/// @param info exit information (si_code is CLD_EXITED, CLD_KILLED or CLD_DUMPED, si_status is exit status or signal,
+		///             si_code is zero if the exit status is unknown)
+		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+		virtual int exited(procepoller &sender, const siginfo_t *info);
+	};
+
+	int                pidfd;    ///< process file descriptor
+	pid_t              pid;      ///< process ID of the child (kept after exit until next spawn)
+	struct epoller    *epoller;  ///< parent epoller
+	struct epoll_event event;    ///< epoll event
+	struct receiver   *rcvr;     ///< event receiver
+	fdepoller          in_pipe;  ///< pipe connected to the child's stdin (for writing)
+	fdepoller          out_pipe; ///< pipe connected to the child's stdout (for reading)
+	fdepoller          err_pipe; ///< pipe connected to the child's stderr (for reading)
+
+	/// @brief Called when the child has exited (and it has been reaped).
+	/// @param sender event sender
+	/// @param info exit information (si_code is CLD_EXITED, CLD_KILLED or CLD_DUMPED, si_status is exit status or signal,
+	///             si_code is zero if the exit status is unknown)
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int (*_exited) (procepoller &sender, const siginfo_t *info);
+
+	/// @brief Constructor.
+	/// @param epoller parent epoller
+	procepoller(struct epoller *epoller) :
+	    pidfd    (-1     ),
+	    pid      (-1     ),
+	    epoller  (epoller),
+	    event    (       ),
+	    rcvr     (0      ),
+	    in_pipe  (epoller),
+	    out_pipe (epoller),
+	    err_pipe (epoller),
+	    _exited  (0      )
+	{}
+
+	/// @brief Default constructor.
+	procepoller() : procepoller(0) {}
+
+	/// @brief Destructor.
+	virtual ~procepoller() {cleanup();}
+
+	/// @brief Spawns the child process.
+	///
+	/// Pipes left from the previous child are closed. The child starts with empty signal mask and default
+	/// signal dispositions, even if the parent blocks signals (e.g. for sigepoller) or ignores them.
+	/// If any pipe cannot be set up, the child is killed and reaped and no pipe is left open.
+	///
+	/// @param path path of the executable
+	/// @param argv arguments (terminated by null pointer)
+	/// @param envp environment (terminated by null pointer), null pointer for environment of the calling process
+	/// @param stdio PROCEPOLLER_STDIN, PROCEPOLLER_STDOUT and PROCEPOLLER_STDERR flags for streams to be piped,
+	///              other streams are inherited
+	/// @param pipesize size of rx/tx buffers of the pipes in bytes
+	/// @return @c true if spawning was successful, otherwise @c false
+	virtual bool spawn(const char *path, char *const argv[], char *const envp[] = 0,
+	                   int stdio = PROCEPOLLER_STDIN | PROCEPOLLER_STDOUT | PROCEPOLLER_STDERR, size_t pipesize = 4096);
+
+	/// @brief Cleanups the process epoller, the pipes are closed.
+	///
+	/// The child is neither killed nor reaped, if it is still running.
+	virtual void cleanup();
+
+	/// @brief Sends signal to the child (by pidfd_send_signal, so the signal cannot hit recycled process ID).
+	/// @param sig signal number
+	/// @return @c true if sending was successful, otherwise @c false
+	bool kill(int sig = SIGTERM);
+
+	/// @brief Checks whether the child is running (it has not been reaped yet).
+	bool running() const {return pidfd != -1;}
+
+	/// @copydoc epoller_event::handler
+	virtual int handler(struct epoller *epoller, struct epoll_event *revent);
+
+	/// @brief Called when the child has exited (and it has been reaped).
+	///
+	/// Default implementation calls receiver::exited method of #rcvr if not null,
+	/// otherwise calls #_exited if not null,
+	/// otherwise returns -1.
+	///
+	/// @param info exit information (si_code is CLD_EXITED, CLD_KILLED or CLD_DUMPED, si_status is exit status or signal,
+	///             si_code is zero if the exit status is unknown)
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int exited(const siginfo_t *info);
+
+	/// @brief Removes the process file descriptor from parent epoller and closes it.
+	void close_pidfd();
+};
+
+#endif // PROCEPOLLER_H
@@ -7,8 +7,19 @@
 
 #include <epoller/epoller.h>
 #include <sys/signalfd.h>
+#include <signal.h>
+#include <vector>
+
+/// @brief Default maximum number of signals read at once.
+#define SIGEPOLLER_BATCH 16
 
 /// @brief Signal epoller.
+///
+/// Received signals are read in batches (up to #batch signals per read) and each one is dispatched to the receiver
+/// subscribed for its number (see #subscribe), or to #sighandler if there is none.
+///
+/// If a callback returns nonzero, signals of the batch not dispatched yet are kept in #siginfos and they are
+/// dispatched before the next read (just before next epoll_wait at the latest), so none of them is lost.
 struct sigepoller : epoller_event
 {
 	/// @brief Event receiver interface.
@@ -25,10 +36,17 @@ struct sigepoller : epoller_event
 		virtual int sighandler(sigepoller &sender, struct signalfd_siginfo *siginfo);
 	};
 
-	int                fd;      ///< signal file descriptor
-	struct epoller    *epoller; ///< parent epoller
-	struct epoll_event event;   ///< epoll event
-	struct receiver   *rcvr;    ///< event receiver
+	int                                  fd;            ///< signal file descriptor
+	struct epoller                      *epoller;       ///< parent epoller
+	struct epoll_event                   event;         ///< epoll event
+	struct receiver                     *rcvr;          ///< event receiver
+	unsigned int                         batch;         ///< maximum number of signals read at once
+	sigset_t                             sigset;        ///< set of signals accepted by the signal epoller
+	struct receiver                     *routes[_NSIG]; ///< receivers subscribed for signal numbers
+	std::vector<struct signalfd_siginfo> siginfos;      ///< buffer for read signals
+	size_t                               pending_pos;   ///< index of the first read signal not dispatched yet
+	size_t                               pending_cnt;   ///< number of read signals in #siginfos
+	bool                                 queued;        ///< added to flush list of parent epoller (see #flush)
 
 	/// @brief Called when signal is received.
 	/// @param sender event sender
@@ -38,7 +56,22 @@ struct sigepoller : epoller_event
 
 	/// @brief Constructor.
 	/// @param epoller parent epoller
-	sigepoller(struct epoller *epoller) : fd(-1), epoller(epoller), event(), rcvr(0), _sighandler(0) {}
+	sigepoller(struct epoller *epoller) :
+	    fd          (-1              ),
+	    epoller     (epoller         ),
+	    event       (                ),
+	    rcvr        (0               ),
+	    batch       (SIGEPOLLER_BATCH),
+	    sigset      (                ),
+	    routes      (                ),
+	    siginfos    (                ),
+	    pending_pos (0               ),
+	    pending_cnt (0               ),
+	    queued      (false           ),
+	    _sighandler (0               )
+	{
+		sigemptyset(&sigset);
+	}
 
 	/// @brief Default constructor.
 	sigepoller() : sigepoller(0) {}
@@ -54,9 +87,27 @@ struct sigepoller : epoller_event
 	/// @brief Cleanups the signal epoller.
 	virtual void cleanup();
 
+	/// @brief Subscribes receiver for given signal number.
+	///
+	/// The signal is added to the set of accepted signals (if the signal epoller is initialized already,
+	/// the signal file descriptor is updated). The signal must be blocked by the caller (see signalfd).
+	///
+	/// @param signo signal number
+	/// @param rcvr receiver, which gets all signals of the number, zero to route them to #sighandler again
+	/// @return @c true if subscription was successful, otherwise @c false
+	bool subscribe(int signo, struct receiver *rcvr);
+
+	/// @brief Unsubscribes receiver of given signal number, the signal stays accepted and it is passed to #sighandler.
+	/// @param signo signal number
+	void unsubscribe(int signo) {if (signo > 0 && signo < _NSIG) routes[signo] = 0;}
+
 	/// @copydoc epoller_event::handler
 	virtual int handler(struct epoller *epoller, struct epoll_event *revent);
 
+	/// @brief Dispatches read signals left undispatched by previous callback returning nonzero.
+	/// @copydoc epoller_event::flush
+	virtual int flush(struct epoller *epoller, int *timeout);
+
 	/// @brief Called when signal is received.
 	///
 	/// Default implementation calls receiver::sighandler method of #rcvr if not null,
@@ -66,6 +117,16 @@ struct sigepoller : epoller_event
 	/// @param siginfo structure with information about the received signal
 	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
 	virtual int sighandler(struct signalfd_siginfo *siginfo);
+
+	/// @brief Dispatches received signal to the subscribed receiver or to #sighandler.
+	/// @param siginfo structure with information about the received signal
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int route(struct signalfd_siginfo *siginfo);
+
+	/// @brief Dispatches read signals not dispatched yet by #route.
+	///        If a callback returns nonzero, the rest is queued to be flushed.
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int dispatch();
 };
 
 #endif // SIGEPOLLER_H
@@ -14,12 +14,43 @@
 /// @brief General socket epoller based on file descriptor epoller.
 struct sockepoller : fdepoller
 {
-	int rx_flags; ///< flags passed to recv
-	int tx_flags; ///< flags passed to send
+	/// @brief Event receiver interface.
+	struct receiver : virtual fdepoller::receiver
+	{
+		/// @brief Destructor.
+		virtual ~receiver() {}
+
+		/// @brief Called if #txbuff has crossed high or low watermark.
+		///        Default implementation returns -1.
+		/// @param sender event sender
+		/// @param writable @c false if high watermark has been reached, @c true if data have drained down to low watermark
+		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+		virtual int wmark(sockepoller &sender, bool writable);
+	};
+
+	int    rx_flags;    ///< flags passed to recv
+	int    tx_flags;    ///< flags passed to send
+	size_t tx_lowat;    ///< low watermark of #txbuff
+	size_t tx_hiwat;    ///< high watermark of #txbuff, zero means watermarks are disabled
+	bool   tx_writable; ///< watermark state, @c false between reaching #tx_hiwat and draining down to #tx_lowat
+
+	/// @brief Called if #txbuff has crossed high or low watermark.
+	/// @param sender event sender
+	/// @param writable @c false if high watermark has been reached, @c true if data have drained down to low watermark
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int (*_wmark) (sockepoller &sender, bool writable);
 
 	/// @brief Constructor.
 	/// @param epoller parent epoller
-	sockepoller(struct epoller *epoller) : fdepoller(epoller), rx_flags(0), tx_flags(0) {}
+	sockepoller(struct epoller *epoller) :
+	    fdepoller  (epoller),
+	    rx_flags   (0      ),
+	    tx_flags   (0      ),
+	    tx_lowat   (0      ),
+	    tx_hiwat   (0      ),
+	    tx_writable(true   ),
+	    _wmark     (0      )
+	{}
 
 	/// @brief Default constructor.
 	sockepoller() : sockepoller(0) {}
@@ -92,6 +123,19 @@ struct sockepoller : fdepoller
 	/// @return @c true if socket was successfully connected, otherwise @c false
 	virtual bool connect(const std::string &ip, unsigned short port);
 
+	/// @brief Connects socket of AF_INET/AF_INET6 domain using TCP Fast Open.
+	///
+	/// Given data are sent within the SYN segment if the peer's fast open cookie is cached,
+	/// otherwise the regular three-way handshake is performed and no data are sent
+	/// (the data should be sent again after the connection is established).
+	///
+	/// @param ip ip address (IPv4/IPv6) the socket should be connected to
+	/// @param port port number the socket should be connected to
+	/// @param buff data to be sent within the SYN segment
+	/// @param len length of data
+	/// @return number of bytes sent within the SYN segment (>=0) or -1 if connecting failed
+	virtual ssize_t connect_fastopen(const std::string &ip, unsigned short port, const void *buff, size_t len);
+
 	/// @brief Gets socket domain.
 	/// @param domain socket domain (AF_INET, AF_INET6, AF_UNIX, ...)
 	/// @return @c true if getting was successful, otherwise @c false
@@ -279,6 +323,47 @@ struct sockepoller : fdepoller
 	/// @return @c true if getting was successful, otherwise @c false
 	bool get_so_tcp_syncnt(int *value);
 
+	/// @brief Sets TCP_FASTOPEN socket option.
+	///
+	/// Enables TCP Fast Open on listening socket. Must be set before the socket is turned into passive state.
+	///
+	/// @param value maximum length of pending fast open requests queue, zero disables fast open
+	/// @return @c true if setting was successful, otherwise @c false
+	bool set_so_tcp_fastopen(int value);
+
+	/// @brief Gets TCP_FASTOPEN socket option.
+	/// @param value
+	/// @return @c true if getting was successful, otherwise @c false
+	bool get_so_tcp_fastopen(int *value);
+
+	/// @brief Sets TCP_FASTOPEN_CONNECT socket option.
+	///
+	/// When enabled, the connect call returns immediately and the SYN segment is deferred
+	/// until the first data are written, so they may be carried within it.
+	///
+	/// @param enabled @c true if fast open on connect should be enabled, otherwise @c false
+	/// @return @c true if setting was successful, otherwise @c false
+	bool set_so_tcp_fastopen_connect(bool enabled);
+
+	/// @brief Gets TCP_FASTOPEN_CONNECT socket option.
+	/// @param enabled
+	/// @return @c true if getting was successful, otherwise @c false
+	bool get_so_tcp_fastopen_connect(bool *enabled);
+
+	/// @brief Sets TCP_NOTSENT_LOWAT socket option.
+	///
+	/// Limits the amount of unsent data in the socket send buffer, so the socket is reported
+	/// as writable only if the amount of unsent data is below the given value.
+	///
+	/// @param value maximum amount of unsent data in bytes
+	/// @return @c true if setting was successful, otherwise @c false
+	bool set_so_tcp_notsent_lowat(int value);
+
+	/// @brief Gets TCP_NOTSENT_LOWAT socket option.
+	/// @param value
+	/// @return @c true if getting was successful, otherwise @c false
+	bool get_so_tcp_notsent_lowat(int *value);
+
 	/// @brief Gets TCP_INFO socket option.
 	/// @param tcp_info pointer to structure where the info should be stored, see include/tcp.h
 	/// @return @c true if getting was successful, otherwise @c false
@@ -292,11 +377,47 @@ struct sockepoller : fdepoller
 	/// @return @c true if filling was successful, otherwise @c false
 	bool fill_addr_inet(const std::string &ip, unsigned short port, struct sockaddr_storage *addr, socklen_t *addr_len);
 
+	/// @brief Enables write backpressure.
+	///
+	/// Unsent data in the kernel are limited by TCP_NOTSENT_LOWAT socket option, so they are kept in #txbuff instead.
+	/// When #txbuff fills up to high watermark, #wmark is called with @c false. Producers should stop generating
+	/// data until #wmark is called with @c true, that happens when #txbuff drains down to low watermark.
+	///
+	/// @param notsent_lowat value of TCP_NOTSENT_LOWAT socket option, zero means the option is left untouched
+	/// @param lowat low watermark of #txbuff in bytes
+	/// @param hiwat high watermark of #txbuff in bytes, zero disables the watermarks
+	/// @return @c true if enabling was successful, otherwise @c false
+	bool set_backpressure(int notsent_lowat, size_t lowat, size_t hiwat);
+
+	/// @brief Called if #txbuff has crossed high or low watermark.
+	///
+	/// Default implementation calls receiver::wmark method of #rcvr if not null,
+	/// otherwise calls #_wmark if not null,
+	/// otherwise returns -1.
+	///
+	/// @param writable @c false if high watermark has been reached, @c true if data have drained down to low watermark
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int wmark(bool writable);
+
+	/// @brief Does the same as fdepoller::write_stream, but checks high watermark of #txbuff.
+	///        Non-zero return value of #wmark is passed to epoller::exit.
+	/// @see fdepoller::write_stream
+	virtual ssize_t write_stream(const void *buff, size_t len);
+
+	/// @brief Does the same as fdepoller::flush, but calls wmark if pending data drop to low watermark.
+	/// @copydoc fdepoller::flush
+	virtual int flush(struct epoller *epoller, int *timeout);
+
+	/// @brief Transmits file region direct to socket by sendfile syscall.
+	/// @see fdepoller::send_file
+	virtual ssize_t send_file(int in_fd, off_t *offset, size_t len);
+
 	/// @brief Does the same as fdepoller::epoll_in, but uses recv filled with #rx_flags.
 	/// @see fdepoller::epoll_in
 	virtual int epoll_in();
 
-	/// @brief Does the same as fdepoller::epoll_out, but uses send filled with #tx_flags.
+	/// @brief Does the same as fdepoller::epoll_out, but uses send filled with #tx_flags
+	///        and checks low watermark of #txbuff.
 	/// @see fdepoller::epoll_out
 	virtual int epoll_out();
 
@@ -25,6 +25,7 @@ struct tcpcepoller : sockepoller
 	};
 
 	bool connecting; ///< connecting state flag
+	bool fastopen;   ///< TCP Fast Open flag, data pending in #txbuff are sent within the SYN segment when connecting
 
 	/// @brief Called if connecting is done.
 	/// @param sender event sender
@@ -34,7 +35,7 @@ struct tcpcepoller : sockepoller
 
 	/// @brief Constructor.
 	/// @param epoller parent epoller
-	tcpcepoller(struct epoller *epoller) : sockepoller(epoller), connecting(false), _con(0) {}
+	tcpcepoller(struct epoller *epoller) : sockepoller(epoller), connecting(false), fastopen(false), _con(0) {}
 
 	/// @brief Default constructor.
 	tcpcepoller() : tcpcepoller(0) {}
@@ -60,6 +61,10 @@ struct tcpcepoller : sockepoller
 	/// No #tx method will be called in connecting state as EPOLLOUT event is fully consumed by #epoll_out handler.
 	/// Neither #rx nor #pri methods will be called as these events are not enabled.
 	///
+	/// If #fastopen is set and there are some data pending in #txbuff, they are sent within the SYN segment
+	/// (if the peer's fast open cookie is cached). The data which couldn't be sent within the SYN segment
+	/// remain in #txbuff and they are transmitted after the connection is established.
+	///
 	/// @param ip ip address (IPv4/IPv6) the socket should be connected to
 	/// @param port port number the socket should be connected to
 	/// @return @c true if connecting was successfully started, otherwise @c false
@@ -47,8 +47,9 @@ struct tcpsepoller : sockepoller
 	/// @param port port number the socket should be bound to
 	/// @param backlog maximum number of pending connections (before they are refused)
 	/// @param reuseaddr @c true if address reusing should be enabled, otherwise @c false
+	/// @param fastopen maximum length of pending TCP Fast Open requests queue, zero means fast open disabled
 	/// @return @c true if socket was created successfully, otherwise @c false
-	virtual bool socket(int domain, const std::string &ip, unsigned short port, int backlog = 1, bool reuseaddr = true);
+	virtual bool socket(int domain, const std::string &ip, unsigned short port, int backlog = 1, bool reuseaddr = true, int fastopen = 0);
 
 	/// @brief Called if accepting is done.
 	///
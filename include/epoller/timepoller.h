@@ -114,6 +114,14 @@ struct timepoller : epoller_event
 	/// @return @c true if timer was disarmed successfully, otherwise @c false
 	bool disarm();
 
+	/// @brief Detaches the timer epoller from parent epoller, the timer keeps running.
+	/// @copydoc epoller_event::detach
+	virtual bool detach();
+
+	/// @brief Attaches the timer epoller to given epoller, expirations since detaching are reported then.
+	/// @copydoc epoller_event::attach
+	virtual bool attach(struct epoller *epoller);
+
 	/// @copydoc epoller_event::handler
 	virtual int handler(struct epoller *epoller, struct epoll_event *revent);
 
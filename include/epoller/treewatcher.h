@@ -0,0 +1,246 @@
+/// @file   epoller/treewatcher.h
+/// @author speedak
+/// @brief  Recursive directory tree watcher.
+
+#ifndef TREEWATCHER_H
+#define TREEWATCHER_H
+
+#include <epoller/inotepoller.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+
+/// @brief Default mask of events reported by tree watcher.
+#define TREEWATCHER_MASK (IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO)
+
+/// @brief Recursive directory tree watcher.
+///
+/// Every directory of the tree is watched, watches for new (or moved in) subdirectories are added automatically.
+/// Directories are kept as a tree of nodes mapped by watch descriptors, each node holds its parent and its name
+/// only (names are interned), so paths relative to the root are built on demand and a moved directory is just
+/// relinked. IN_MOVED_FROM and IN_MOVED_TO events are paired by cookie and reported by single #moved call.
+///
+/// The initial tree is scanned by several threads (see #watch), later changes are handled within the thread
+/// running the parent epoller.
+struct treewatcher : inotepoller
+{
+	/// @brief Event receiver interface.
+	struct receiver : virtual inotepoller::receiver
+	{
+		/// @brief Destructor.
+		virtual ~receiver() {}
+
+		/// @brief Called when an entry of the tree has changed.
+		///        Default implementation returns -1.
+		/// @param sender event sender
+		/// @param mask inotify event mask (IN_CREATE, IN_DELETE, ..., IN_ISDIR)
+		/// @param path path of the entry relative to the root
+		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+		virtual int changed(treewatcher &sender, uint32_t mask, const std::string &path);
+
+		/// @brief Called when an entry has been moved within, into or out of the tree.
+		///        Default implementation returns -1.
+		/// @param sender event sender
+		/// @param mask inotify event mask (IN_MOVE, IN_ISDIR)
+		/// @param from old path relative to the root, empty if moved into the tree
+		/// @param to new path relative to the root, empty if moved out of the tree
+		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+		virtual int moved(treewatcher &sender, uint32_t mask, const std::string &from, const std::string &to);
+
+		/// @brief Called when event queue has overflowed, the tree should be watched again.
+		///        Default implementation returns -1.
+		/// @param sender event sender
+		/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+		virtual int lost(treewatcher &sender);
+	};
+
+	/// @brief Watched directory.
+	struct node
+	{
+		int                wd;       ///< watch descriptor
+		struct node       *parent;   ///< parent directory, null for the root
+		const std::string *name;     ///< interned name (empty for the root)
+		struct node       *children; ///< first subdirectory
+		struct node       *prev;     ///< previous sibling
+		struct node       *next;     ///< next sibling
+	};
+
+	/// @brief Key of subdirectory (parent node and interned name).
+	typedef std::pair<const struct node*, const std::string*> child_key;
+
+	/// @brief Hash of subdirectory key.
+	struct child_hash
+	{
+		size_t operator()(const child_key &key) const {
+			return std::hash<const void*>()(key.first) * 31 + std::hash<const void*>()(key.second);
+		}
+	};
+
+	/// @brief IN_MOVED_FROM event waiting for its IN_MOVED_TO pair.
+	struct pending_move
+	{
+		uint32_t     cookie; ///< cookie of the event
+		uint32_t     mask;   ///< mask of the event
+		std::string  from;   ///< old path
+		struct node *dir;    ///< moved directory, null if not a directory (or not watched)
+	};
+
+	std::string                                               root;     ///< root directory
+	uint32_t                                                  mask;     ///< reported events
+	struct node                                              *top;      ///< root node
+	std::unordered_map<int, struct node*>                     nodes;    ///< nodes by watch descriptors
+	std::unordered_map<child_key, struct node*, child_hash>   children; ///< nodes by parents and names
+	std::unordered_map<std::string, unsigned int>             names;    ///< interned names with numbers of their nodes
+	struct pending_move                                       move;     ///< IN_MOVED_FROM event waiting for its pair
+	bool                                                      moving;   ///< #move is valid
+
+	/// @brief Called when an entry of the tree has changed.
+	/// @param sender event sender
+	/// @param mask inotify event mask (IN_CREATE, IN_DELETE, ..., IN_ISDIR)
+	/// @param path path of the entry relative to the root
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int (*_changed) (treewatcher &sender, uint32_t mask, const std::string &path);
+
+	/// @brief Called when an entry has been moved within, into or out of the tree.
+	/// @param sender event sender
+	/// @param mask inotify event mask (IN_MOVE, IN_ISDIR)
+	/// @param from old path relative to the root, empty if moved into the tree
+	/// @param to new path relative to the root, empty if moved out of the tree
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int (*_moved) (treewatcher &sender, uint32_t mask, const std::string &from, const std::string &to);
+
+	/// @brief Called when event queue has overflowed, the tree should be watched again.
+	/// @param sender event sender
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int (*_lost) (treewatcher &sender);
+
+	/// @brief Constructor.
+	/// @param epoller parent epoller
+	treewatcher(struct epoller *epoller) :
+	    inotepoller (epoller         ),
+	    root        (                ),
+	    mask        (TREEWATCHER_MASK),
+	    top         (0               ),
+	    nodes       (                ),
+	    children    (                ),
+	    names       (                ),
+	    move        (                ),
+	    moving      (false           ),
+	    _changed    (0               ),
+	    _moved      (0               ),
+	    _lost       (0               )
+	{}
+
+	/// @brief Default constructor.
+	treewatcher() : treewatcher(0) {}
+
+	/// @brief Destructor.
+	virtual ~treewatcher() {cleanup();}
+
+	/// @brief Cleanups the tree watcher, all watches are removed.
+	virtual void cleanup();
+
+	/// @brief Watches directory tree (the inotify epoller must be initialized), previous tree is unwatched.
+	///
+	/// Subdirectories are scanned in parallel, entries created meanwhile may be reported by #changed.
+	///
+	/// @param root root directory
+	/// @param threads number of scanning threads, zero for number of CPUs
+	/// @return @c true if watching was successful, otherwise @c false
+	bool watch(const std::string &root, unsigned int threads = 0);
+
+	/// @brief Removes all watches.
+	void unwatch();
+
+	/// @brief Builds path of watched directory relative to the root.
+	/// @param n node of the directory
+	/// @param name name of entry within the directory to be appended, null for the directory itself
+	/// @return relative path (empty for the root)
+	std::string path(const struct node *n, const char *name = 0) const;
+
+	/// @brief Dispatches inotify events, pending IN_MOVED_FROM event is reported as moved out of the tree
+	///        when no more events are queued.
+	/// @copydoc epoller_event::handler
+	virtual int handler(struct epoller *epoller, struct epoll_event *revent);
+
+	/// @brief Dispatches events left undispatched by #handler, pending IN_MOVED_FROM event is reported
+	///        as moved out of the tree when no more events are queued.
+	/// @copydoc inotepoller::flush
+	virtual int flush(struct epoller *epoller, int *timeout);
+
+	/// @brief Maintains the tree and reports the event by #changed or #moved.
+	/// @copydoc inotepoller::inothandler
+	virtual int inothandler(struct inotify_event *event);
+
+	/// @brief Reports the overflow by #lost.
+	/// @copydoc inotepoller::overflow
+	virtual int overflow(struct inotify_event *event);
+
+	/// @brief Called when an entry of the tree has changed.
+	///
+	/// Default implementation calls receiver::changed method of #rcvr if not null,
+	/// otherwise calls #_changed if not null,
+	/// otherwise returns -1.
+	///
+	/// @param mask inotify event mask (IN_CREATE, IN_DELETE, ..., IN_ISDIR)
+	/// @param path path of the entry relative to the root
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int changed(uint32_t mask, const std::string &path);
+
+	/// @brief Called when an entry has been moved within, into or out of the tree.
+	///
+	/// Default implementation calls receiver::moved method of #rcvr if not null,
+	/// otherwise calls #_moved if not null,
+	/// otherwise returns -1.
+	///
+	/// @param mask inotify event mask (IN_MOVE, IN_ISDIR)
+	/// @param from old path relative to the root, empty if moved into the tree
+	/// @param to new path relative to the root, empty if moved out of the tree
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int moved(uint32_t mask, const std::string &from, const std::string &to);
+
+	/// @brief Called when event queue has overflowed, the tree should be watched again.
+	///
+	/// Default implementation calls receiver::lost method of #rcvr if not null,
+	/// otherwise calls #_lost if not null,
+	/// otherwise returns -1.
+	///
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	virtual int lost();
+
+	/// @brief Interns name for a node.
+	/// @return interned name, valid until the last node using it releases it
+	const std::string *intern(const std::string &name);
+
+	/// @brief Releases interned name of a node, the name is dropped when no other node uses it.
+	void release(const std::string *name);
+
+	/// @brief Adds node of watched directory (if it is not known yet).
+	/// @return added node, null if the watch descriptor is known already
+	struct node *add_node(int wd, struct node *parent, const std::string &name);
+
+	/// @brief Removes node (and its subtree).
+	/// @param rm if @c true the watches are removed as well
+	void del_node(struct node *n, bool rm);
+
+	/// @brief Relinks node under new parent with new name.
+	void move_node(struct node *n, struct node *parent, const std::string &name);
+
+	/// @brief Scans subtree and adds watches for all its directories.
+	/// @param n node of the subtree root
+	/// @param threads number of scanning threads
+	/// @param found if not null, relative paths (with IN_ISDIR flags) of all found entries are appended
+	void scan(struct node *n, unsigned int threads, std::vector<std::pair<std::string, uint32_t> > *found);
+
+	/// @brief Reports the pending IN_MOVED_FROM event as moved out of the tree.
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int flush_move();
+
+	/// @brief Reports the pending IN_MOVED_FROM event by #flush_move if no more events are queued.
+	/// @return zero for loop continuation, positive for normal loop exit, negative for loop exit with error
+	int check_move();
+};
+
+#endif // TREEWATCHER_H
@@ -0,0 +1,221 @@
+#include <epoller/acceptor.h>
+#include <epoller/log.h>
+#include <errno.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+#define DBG_PREFIX "acceptor: "
+
+int acceptor_worker::receiver::acc(acceptor_worker &sender, int fd, const struct sockaddr *addr, socklen_t addrlen)
+{
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: acc");
+	::close(fd);
+	return -1;
+}
+
+bool acceptor_worker::init(size_t size)
+{
+	size_t n = 2;
+
+	while (n < size)
+		n <<= 1;
+	ring.resize(n);
+	head.store(0);
+	tail.store(0);
+
+	wakeup.rcvr = this;
+	if (!wakeup.init(0, EFD_NONBLOCK)) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"wakeup event initialization failed");
+		return false;
+	}
+
+	return true;
+}
+
+void acceptor_worker::cleanup()
+{
+	size_t h = head.load(std::memory_order_acquire), t = tail.load(std::memory_order_acquire);
+
+	for (; h != t; ++h)
+		::close(ring[h & (ring.size() - 1)].fd);
+	head.store(h, std::memory_order_release);
+
+	wakeup.cleanup();
+}
+
+bool acceptor_worker::push(int fd, const struct sockaddr_storage *addr, socklen_t addrlen)
+{
+	size_t t = tail.load(std::memory_order_relaxed);
+
+	if (t - head.load(std::memory_order_acquire) == ring.size())
+		return false;
+
+	struct slot &s = ring[t & (ring.size() - 1)];
+	s.fd      = fd;
+	s.addrlen = addrlen;
+	memcpy(&s.addr, addr, std::min((size_t) addrlen, sizeof s.addr));
+
+	tail.store(t + 1, std::memory_order_release);
+	return true;
+}
+
+int acceptor_worker::recv_handler(evepoller &sender, uint64_t cnt)
+{
+	size_t h = head.load(std::memory_order_relaxed), t = tail.load(std::memory_order_acquire);
+	struct slot s;
+	int ret;
+
+	while (h != t) {
+		s = ring[h & (ring.size() - 1)];
+		head.store(++h, std::memory_order_release);
+
+		conns.fetch_add(1, std::memory_order_relaxed);
+		ret = acc(s.fd, (const struct sockaddr *) &s.addr, s.addrlen);
+		if (ret)
+			return ret;
+
+		if (h == t)
+			t = tail.load(std::memory_order_acquire);
+	}
+
+	return 0;
+}
+
+int acceptor_worker::acc(int fd, const struct sockaddr *addr, socklen_t addrlen)
+{
+	if (rcvr)
+		return rcvr->acc(*this, fd, addr, addrlen);
+	else if (_acc)
+		return _acc(*this, fd, addr, addrlen);
+	else {
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: acc");
+		::close(fd);
+		return -1;
+	}
+}
+
+size_t acceptor_round_robin::pick(const std::vector<acceptor_worker*> &workers)
+{
+	size_t ix = next++ % workers.size();
+
+	next %= workers.size();
+	return ix;
+}
+
+size_t acceptor_least_conns::pick(const std::vector<acceptor_worker*> &workers)
+{
+	size_t ix = 0;
+	long conns, min = workers[0]->conns.load(std::memory_order_relaxed) + workers[0]->queued();
+
+	for (size_t i = 1; i < workers.size(); ++i) {
+		conns = workers[i]->conns.load(std::memory_order_relaxed) + workers[i]->queued();
+		if (conns < min) {
+			min = conns;
+			ix  = i;
+		}
+	}
+
+	return ix;
+}
+
+size_t acceptor_least_queue::pick(const std::vector<acceptor_worker*> &workers)
+{
+	size_t ix = 0, queued, min = workers[0]->queued();
+
+	for (size_t i = 1; i < workers.size() && min; ++i) {
+		queued = workers[i]->queued();
+		if (queued < min) {
+			min = queued;
+			ix  = i;
+		}
+	}
+
+	return ix;
+}
+
+int acceptor::epoll_in()
+{
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+	size_t ix, k, n = workers.size();
+	unsigned int i;
+	int new_fd;
+
+	if (workers.empty()) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"no workers");
+		return -1;
+	}
+
+	// the timer is created in advance, as there may be no free file descriptor when it is needed
+	if (backoff_timer.fd == -1) {
+		backoff_timer.epoller = epoller;
+		backoff_timer.rcvr    = this;
+		if (!backoff_timer.init()) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"backoff timer initialization failed");
+			return -1;
+		}
+	}
+
+	woken.assign(n, false);
+	for (i = 0; i < batch; ++i) {
+		addrlen = sizeof addr;
+		new_fd  = accept4(fd, (struct sockaddr *) &addr, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (new_fd == -1) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if (errno == ECONNABORTED || errno == EINTR)
+				continue;
+			if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+				ELOG_ERRNO(ELOG_WARNING, DBG_PREFIX"accepting suspended");
+				if (!backoff())
+					return -1;
+				break;
+			}
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"accepting on socket epoller failed");
+			break;
+		}
+		accepted++;
+
+		// push to the chosen worker or to the next one with free space
+		ix = (policy ? policy : &rr)->pick(workers);
+		for (k = 0; k < n && !workers[(ix + k) % n]->push(new_fd, &addr, addrlen); ++k)
+			;
+		if (k == n) {
+			ELOG(ELOG_WARNING, DBG_PREFIX"rings of all workers are full, connection dropped");
+			::close(new_fd);
+			dropped++;
+			continue;
+		}
+		woken[(ix + k) % n] = true;
+	}
+
+	// wake up every affected worker once per batch
+	for (ix = 0; ix < n; ++ix)
+		if (woken[ix] && !workers[ix]->wakeup.send())
+			ELOG(ELOG_ERROR, DBG_PREFIX"waking worker up failed");
+
+	return 0;
+}
+
+bool acceptor::backoff()
+{
+	if (!disable() || !backoff_timer.arm_oneshot_msec(backoff_msec))
+		return false;
+
+	backoff_cnt++;
+	return true;
+}
+
+int acceptor::timerhandler(timepoller &sender, uint64_t exp)
+{
+	if (fd == -1 || enabled)
+		return 0; // closed or enabled meanwhile
+
+	if (!enable(true, false, false)) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"resuming accepting failed");
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,31 @@
+#include <epoller/balancer.h>
+#include <algorithm>
+
+int balancer::rebalance(migrator &source)
+{
+	migrator *target = 0;
+	double from = source.load.load(), to;
+	size_t n;
+
+	if (from < min_load || source.members.empty())
+		return 0;
+
+	// find the least loaded epoller
+	for (size_t i = 0; i < loops.size(); ++i)
+		if (loops[i] != &source && (!target || loops[i]->load.load() < target->load.load()))
+			target = loops[i];
+	if (!target)
+		return 0;
+
+	to = target->load.load();
+	if (from <= to * (1 + threshold))
+		return 0;
+
+	// move events, which would halve the difference (provided that they generate equal load)
+	n = std::min((size_t) (source.members.size() * (from - to) / (2 * from)), batch);
+	while (n-- && !source.members.empty())
+		if (!source.migrate(source.members.back(), *target))
+			break;
+
+	return 0;
+}
@@ -1,8 +1,9 @@
 #include <epoller/epoller.h>
+#include <epoller/log.h>
 #include <errno.h>
 #include <unistd.h>
 #include <cstdio>
-#include <iostream>
+#include <algorithm>
 
 #define DBG_PREFIX "epoller: "
 
@@ -10,14 +11,14 @@ bool epoller::init()
 {
 	// check epoll file descriptor
 	if (fd != -1) {
-		std::cerr << DBG_PREFIX"already initialized" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"already initialized");
 		return false;
 	}
 
 	// create epoll file descriptor
 	fd = epoll_create(1);
 	if (fd == -1) {
-		perror(DBG_PREFIX"epoll file descriptor creation failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"epoll file descriptor creation failed");
 		return false;
 	}
 
@@ -37,7 +38,7 @@ void epoller::cleanup()
 
 bool epoller::loop()
 {
-	int r, ret;
+	int r, ret, to;
 
 	loop_exit = 0;
 	while (!loop_exit) {
@@ -49,15 +50,32 @@ bool epoller::loop()
 				loop_exit = 1;
 				break;
 			} else if (r < 0) {
-				std::cerr << DBG_PREFIX"pre_epoll_handler announces exit with error" << std::endl;
+				ELOG(ELOG_ERROR, DBG_PREFIX"pre_epoll_handler announces exit with error");
 				loop_exit = -1;
 				break;
 			}
 		}
 
+		// flush events
+		to = timeout;
+		r = flush(&to);
+		if (r > 0) {
+			loop_exit = 1;
+			break;
+		} else if (r < 0) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"flushed event announces exit with error");
+			loop_exit = -1;
+			break;
+		}
+
+		// do not block if some reception has been deferred
+		if (rx_deferred)
+			to = 0;
+		rx_deferred = 0;
+
 		// call epoll wait
 		do {
-			ret = epoll_wait(fd, revents, revents_size, timeout);
+			ret = epoll_wait(fd, revents, revents_size, to);
 		} while (ret == -1 && errno == EINTR);
 
 		// call post-epoll handler
@@ -67,7 +85,7 @@ bool epoller::loop()
 				loop_exit = 1;
 				break;
 			} else if (r < 0) {
-				std::cerr << DBG_PREFIX"post_epoll_handler announces exit with error" << std::endl;
+				ELOG(ELOG_ERROR, DBG_PREFIX"post_epoll_handler announces exit with error");
 				loop_exit = -1;
 				break;
 			}
@@ -76,20 +94,20 @@ bool epoller::loop()
 		if (ret == -1) {
 
 			// error
-			perror(DBG_PREFIX"epoll waiting failed");
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"epoll waiting failed");
 			loop_exit = -1;
 			break;
 
 		} else if (ret == 0) {
 
-			// call timeout handler
-			if (timeout_handler) {
+			// call timeout handler (unless epoll timeout has been lowered by deferred reception or flushed event)
+			if (timeout_handler && to == timeout) {
 				r = timeout_handler(this);
 				if (r > 0) {
 					loop_exit = 1;
 					break;
 				} else if (r < 0) {
-					std::cerr << DBG_PREFIX"timeout_handler announces exit with error" << std::endl;
+					ELOG(ELOG_ERROR, DBG_PREFIX"timeout_handler announces exit with error");
 					loop_exit = -1;
 					break;
 				}
@@ -97,65 +115,105 @@ bool epoller::loop()
 
 		} else {
 
-			// call revents handler
-			if (revents_handler) {
-				r = revents_handler(this, revents, ret);
-				if (r > 0) {
-					loop_exit = 1;
-					break;
-				} else if (r < 0) {
-					std::cerr << DBG_PREFIX"revents_handler announces exit with error" << std::endl;
-					loop_exit = -1;
-					break;
-				}
-			}
+			// dispatch returned events
+			if (dispatch(ret))
+				break;
 
-			// set pthis member of each event
-			for (int i = 0; i < ret; ++i) {
-				struct epoller_event *ev = (struct epoller_event*) revents[i].data.ptr;
-				if (ev)
-					ev->pthis = (struct epoller_event **) &revents[i].data.ptr;
-				else {
-					std::cerr << DBG_PREFIX"unexpected null pointer to epoll event" << std::endl;
-					loop_exit = -1;
+		}
+	} // while (!loop_exit)
+
+	return loop_exit > 0;
+}
+
+int epoller::dispatch(int n)
+{
+	int r = 0;
+
+	// refill reception budget
+	rx_budget_left = rx_budget;
+
+	// call revents handler
+	if (revents_handler) {
+		r = revents_handler(this, revents, n);
+		if (r > 0) {
+			return loop_exit = 1;
+		} else if (r < 0) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"revents_handler announces exit with error");
+			return loop_exit = -1;
+		}
+	}
+
+	// set pthis member of each event
+	for (int i = 0; i < n; ++i) {
+		struct epoller_event *ev = (struct epoller_event*) revents[i].data.ptr;
+		if (ev)
+			ev->pthis = (struct epoller_event **) &revents[i].data.ptr;
+		else {
+			ELOG(ELOG_ERROR, DBG_PREFIX"unexpected null pointer to epoll event");
+			for (int j = 0; j < i; ++j)
+				((struct epoller_event*) revents[j].data.ptr)->pthis = 0;
+			return loop_exit = -1;
+		}
+	}
+
+	// call handler of each event
+	handled_cnt += n;
+	for (int i = 0; i < n; ++i)
+		if (revents[i].events) {
+			struct epoller_event *ev = (struct epoller_event*) revents[i].data.ptr;
+			if (ev) {
+				r = ev->handler(this, &revents[i]);
+				if (r)
 					break;
-				}
 			}
-			if (loop_exit)
-				break;
+		}
 
-			// call handler of each event
-			for (int i = 0; i < ret; ++i)
-				if (revents[i].events) {
-					struct epoller_event *ev = (struct epoller_event*) revents[i].data.ptr;
-					if (ev) {
-						r = ev->handler(this, &revents[i]);
-						if (r)
-							break;
-					}
-				}
+	// clear pthis member of each event
+	for (int i = 0; i < n; ++i) {
+		struct epoller_event *ev = (struct epoller_event*) revents[i].data.ptr;
+		if (ev)
+			ev->pthis = 0;
+	}
 
-			// clear pthis member of each event
-			for (int i = 0; i < ret; ++i) {
-				struct epoller_event *ev = (struct epoller_event*) revents[i].data.ptr;
-				if (ev)
-					ev->pthis = 0;
-			}
+	// exit if demanded
+	if (r > 0) {
+		return loop_exit = 1;
+	} else if (r < 0) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"epoll event handler announces exit with error");
+		return loop_exit = -1;
+	}
 
-			// exit if demanded
-			if (r > 0) {
-				loop_exit = 1;
-				break;
-			} else if (r < 0) {
-				std::cerr << DBG_PREFIX"epoll event handler announces exit with error" << std::endl;
-				loop_exit = -1;
-				break;
-			}
+	return 0;
+}
 
-		}
-	} // while (!loop_exit)
+void epoller::del_flush(struct epoller_event *ev)
+{
+	// just clear the entry, so the list may be modified while it is flushed
+	std::replace(flushes.begin(), flushes.end(), ev, (struct epoller_event *) 0);
+}
 
-	return loop_exit > 0;
+int epoller::flush(int *timeout)
+{
+	int r = 0;
+	size_t n = flushes.size();
+
+	for (size_t i = 0; i < n && !r; ++i) {
+		struct epoller_event *ev = flushes[i];
+		if (!ev)
+			continue;
+
+		// remove event from the list and set its pthis member for the time of the call
+		flushes[i] = 0;
+		ev->pthis = &ev;
+		r = ev->flush(this, timeout);
+		if (ev)
+			ev->pthis = 0;
+	}
+
+	// drop cleared entries
+	flushes.erase(std::remove(flushes.begin(), flushes.end(), (struct epoller_event *) 0), flushes.end());
+
+	return r;
 }
 
 void epoller::exit(int how)
@@ -1,6 +1,6 @@
 #include <epoller/evepoller.h>
+#include <epoller/log.h>
 #include <unistd.h>
-#include <iostream>
 #include <cstdio>
 #include <cstring>
 
@@ -8,7 +8,7 @@
 
 int evepoller::receiver::recv_handler(evepoller &sender, uint64_t cnt)
 {
-	std::cerr << DBG_PREFIX"unhandled event: recv_handler" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: recv_handler");
 	return -1;
 }
 
@@ -18,14 +18,14 @@ bool evepoller::init(unsigned int cnt, int flags)
 
 	// check file descriptor
 	if (fd != -1) {
-		std::cerr << DBG_PREFIX"already initialized" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"already initialized");
 		goto unwind;
 	}
 
 	// create event file descriptor
 	fd = eventfd(cnt, flags);
 	if (fd == -1) {
-		perror(DBG_PREFIX"file descriptor creation failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"file descriptor creation failed");
 		goto unwind;
 	}
 
@@ -35,7 +35,7 @@ bool evepoller::init(unsigned int cnt, int flags)
 	event.events = EPOLLIN;
 	ret = epoll_ctl(epoller->fd, EPOLL_CTL_ADD, fd, &event);
 	if (ret == -1) {
-		perror(DBG_PREFIX"adding file descriptor to epoller failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"adding file descriptor to epoller failed");
 		goto unwind_fd;
 	}
 
@@ -57,7 +57,7 @@ void evepoller::cleanup()
 
 	// remove event file descriptor from epoller
 	if (epoller->fd != -1 && epoll_ctl(epoller->fd, EPOLL_CTL_DEL, fd, NULL) == -1)
-		perror(DBG_PREFIX"removing file descriptor from epoller failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"removing file descriptor from epoller failed");
 
 	// close and invalidate event file descriptor
 	close(fd);
@@ -67,7 +67,7 @@ void evepoller::cleanup()
 bool evepoller::send(uint64_t cnt)
 {
 	if (write(fd, &cnt, sizeof cnt) != sizeof cnt) {
-		perror(DBG_PREFIX"writing to file descriptor failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"writing to file descriptor failed");
 		return false;
 	}
 
@@ -84,16 +84,16 @@ int evepoller::handler(struct epoller *epoller, struct epoll_event *revent)
 
 		ret = read(fd, &cnt, sizeof cnt);
 		if (ret == -1) {
-			perror(DBG_PREFIX"reading from file descriptor failed");
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"reading from file descriptor failed");
 			return -1;
 
 		} else if (ret == 0) {
-			perror(DBG_PREFIX"no data read from file descriptor");
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"no data read from file descriptor");
 			return -1;
 
 		} else {
 			if (ret != sizeof cnt) {
-				perror(DBG_PREFIX"mismatched data read from file descriptor");
+				ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"mismatched data read from file descriptor");
 				return -1;
 			}
 
@@ -103,18 +103,18 @@ int evepoller::handler(struct epoller *epoller, struct epoll_event *revent)
 
 	if (revent->events & EPOLLHUP) {
 		revent->events &= ~EPOLLHUP;
-		std::cerr << DBG_PREFIX"unexpected EPOLLHUP on file descriptor" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected EPOLLHUP on file descriptor");
 		return -1;
 	}
 
 	if (revent->events & EPOLLERR) {
 		revent->events &= ~EPOLLERR;
-		std::cerr << DBG_PREFIX"unexpected EPOLLERR on file descriptor" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected EPOLLERR on file descriptor");
 		return -1;
 	}
 
 	if (revent->events) {
-		std::cerr << DBG_PREFIX"unexpected unknown event on file descriptor, events = " << revent->events << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected unknown event on file descriptor, events = %u", revent->events);
 		return -1;
 	}
 
@@ -128,7 +128,7 @@ int evepoller::recv_handler(uint64_t cnt)
 	else if (_recv_handler)
 		return _recv_handler(*this, cnt);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: recv_handler" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: recv_handler");
 		return -1;
 	}
 }
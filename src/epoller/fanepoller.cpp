@@ -0,0 +1,394 @@
+#include <epoller/fanepoller.h>
+#include <epoller/log.h>
+#include <sys/vfs.h>
+#include <errno.h>
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#define DBG_PREFIX "fanepoller: "
+
+/// @brief Makes key of filesystem ID.
+static inline uint64_t fsid_key(const int val[2])
+{
+	return ((uint64_t)(uint32_t) val[0] << 32) | (uint32_t) val[1];
+}
+
+/// @brief Gets path of object referred by file descriptor.
+static bool fd_path(int fd, std::string &path)
+{
+	char link[32], buff[PATH_MAX];
+	ssize_t len;
+
+	snprintf(link, sizeof link, "/proc/self/fd/%d", fd);
+	len = readlink(link, buff, sizeof buff);
+	if (len == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"reading link %s failed", link);
+		return false;
+	}
+
+	path.assign(buff, len);
+	return true;
+}
+
+int fanepoller::receiver::fanhandler(fanepoller &sender, const struct fan_event *event)
+{
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: fanhandler");
+	return -1;
+}
+
+int fanepoller::receiver::overflow(fanepoller &sender, const struct fan_event *event)
+{
+	return fanhandler(sender, event);
+}
+
+bool fanepoller::init(unsigned int flags, unsigned int event_f_flags, size_t buffsize)
+{
+	int ret;
+
+	// check file descriptor
+	if (fd != -1) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"already initialized");
+		goto unwind;
+	}
+
+	// create fanotify file descriptor, with reporting of file handles of objects only (kernels 5.1 - 5.8)
+	// or without reporting of file handles if the kernel does not support it
+	fd = fanotify_init(flags, event_f_flags);
+	if (fd == -1 && errno == EINVAL && (flags & FAN_REPORT_FID) && (flags & FANEPOLLER_REPORT_FLAGS) != FAN_REPORT_FID) {
+		ELOG(ELOG_INFO, DBG_PREFIX"reporting of directory file handles not supported, object file handles are used");
+		flags &= ~(FANEPOLLER_REPORT_FLAGS & ~FAN_REPORT_FID);
+		fd = fanotify_init(flags, event_f_flags);
+	}
+	if (fd == -1 && errno == EINVAL && (flags & FANEPOLLER_REPORT_FLAGS)) {
+		ELOG(ELOG_INFO, DBG_PREFIX"reporting of file handles not supported, file descriptors are used");
+		flags &= ~FANEPOLLER_REPORT_FLAGS;
+		fd = fanotify_init(flags, event_f_flags);
+	}
+	if (fd == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"file descriptor creation failed");
+		goto unwind;
+	}
+	this->flags = flags;
+
+	// allocate buffer for read events
+	buff.resize(std::max(buffsize, (size_t) FAN_EVENT_METADATA_LEN + MAX_HANDLE_SZ + NAME_MAX + 64));
+
+	// add fanotify file descriptor to epoller
+	memset(&event, 0, sizeof event);
+	event.data.ptr = this;
+	event.events = EPOLLIN;
+	ret = epoll_ctl(epoller->fd, EPOLL_CTL_ADD, fd, &event);
+	if (ret == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"adding file descriptor to epoller failed");
+		goto unwind_fd;
+	}
+
+	return true;
+
+unwind_fd:
+	close(fd);
+	fd = -1;
+
+unwind:
+	return false;
+}
+
+void fanepoller::cleanup()
+{
+	// close file descriptors of marked filesystems
+	for (auto &it : mounts)
+		close(it.second);
+	mounts.clear();
+
+	// check file descriptor
+	if (fd == -1)
+		return; // already cleaned-up
+
+	// drop events not dispatched yet
+	if (queued) {
+		epoller->del_flush(this);
+		queued = false;
+	}
+	drop();
+
+	// remove fanotify file descriptor from epoller
+	if (epoller->fd != -1 && epoll_ctl(epoller->fd, EPOLL_CTL_DEL, fd, NULL) == -1)
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"removing file descriptor from epoller failed");
+
+	// close and invalidate fanotify file descriptor
+	close(fd);
+	fd = -1;
+}
+
+bool fanepoller::mark(const std::string &pathname, uint64_t mask, unsigned int flags)
+{
+	struct statfs st;
+	int mfd;
+
+	if (fanotify_mark(fd, FAN_MARK_ADD | flags, mask, AT_FDCWD, pathname.c_str()) == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"adding mark for %s failed", pathname.c_str());
+		return false;
+	}
+
+	if (!reports_fid())
+		return true;
+
+	// keep file descriptor of the filesystem for resolving of file handles (O_PATH one is refused by open_by_handle_at)
+	mfd = open(pathname.c_str(), O_RDONLY | O_CLOEXEC);
+	if (mfd == -1) {
+		ELOG_ERRNO(ELOG_WARNING, DBG_PREFIX"opening %s failed, its file handles will not be resolved", pathname.c_str());
+		return true;
+	}
+
+	if (fstatfs(mfd, &st) == -1) {
+		ELOG_ERRNO(ELOG_WARNING, DBG_PREFIX"getting filesystem of %s failed, its file handles will not be resolved",
+		           pathname.c_str());
+		close(mfd);
+		return true;
+	}
+
+	if (!mounts.insert(std::make_pair(fsid_key(st.f_fsid.__val), mfd)).second)
+		close(mfd); // filesystem already known
+
+	return true;
+}
+
+bool fanepoller::unmark(const std::string &pathname, uint64_t mask, unsigned int flags)
+{
+	if (fanotify_mark(fd, FAN_MARK_REMOVE | flags, mask, AT_FDCWD, pathname.c_str()) == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"removing mark for %s failed", pathname.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+int fanepoller::open_fid(const struct fanotify_event_info_fid *fid, int flags)
+{
+	std::unordered_map<uint64_t, int>::iterator it = mounts.find(fsid_key(fid->fsid.val));
+	int ofd;
+
+	if (it == mounts.end()) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"file handle of unknown filesystem");
+		return -1;
+	}
+
+	ofd = open_by_handle_at(it->second, (struct file_handle *) fid->handle, flags);
+	if (ofd == -1)
+		ELOG_ERRNO(ELOG_DEBUG, DBG_PREFIX"opening file handle failed");
+
+	return ofd;
+}
+
+bool fanepoller::resolve(const struct fan_event *event, std::string &path)
+{
+	const struct fanotify_event_info_fid *fid = event->dfid ? event->dfid : event->fid;
+	bool ret;
+	int ofd;
+
+	if (!fid) {
+		if (event->meta->fd < 0) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"nothing to resolve");
+			return false;
+		}
+
+		return fd_path(event->meta->fd, path);
+	}
+
+	ofd = open_fid(fid, O_PATH | O_CLOEXEC);
+	if (ofd == -1)
+		return false;
+
+	ret = fd_path(ofd, path);
+	close(ofd);
+
+	// entry name is relative to the parent directory ("." for the directory itself)
+	if (ret && event->dfid && event->name && strcmp(event->name, ".")) {
+		if (path != "/")
+			path += '/';
+		path += event->name;
+	}
+
+	return ret;
+}
+
+int fanepoller::handler(struct epoller *epoller, struct epoll_event *revent)
+{
+	int ret;
+	ssize_t len;
+	struct epoller_event **pthis = epoller_event::pthis;
+
+	if (revent->events & EPOLLIN) {
+		revent->events &= ~EPOLLIN;
+
+		// events left from the previous read go first
+		ret = dispatch();
+		if (ret || !*pthis || fd == -1)
+			return ret;
+
+		len = read(fd, buff.data(), buff.size());
+		if (len == -1) {
+			ELOG_ERRNO(errno == EAGAIN ? ELOG_DEBUG : ELOG_ERROR, DBG_PREFIX"reading from file descriptor failed");
+			return errno == EAGAIN ? 0 : -1;
+
+		} else if (len == 0) {
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"no data read from file descriptor");
+			return -1;
+		}
+
+		buff_pos = 0;
+		buff_len = len;
+
+		return dispatch();
+	}
+
+	if (revent->events & EPOLLHUP) {
+		revent->events &= ~EPOLLHUP;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected EPOLLHUP on file descriptor");
+		return -1;
+	}
+
+	if (revent->events & EPOLLERR) {
+		revent->events &= ~EPOLLERR;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected EPOLLERR on file descriptor");
+		return -1;
+	}
+
+	if (revent->events) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected unknown event on file descriptor, events = %u", revent->events);
+		return -1;
+	}
+
+	return 0;
+}
+
+int fanepoller::dispatch()
+{
+	int ret, efd;
+	ssize_t len;
+	size_t off;
+	const struct fanotify_event_metadata *meta;
+	const struct fanotify_event_info_header *info;
+	const struct file_handle *handle;
+	struct fan_event ev;
+	struct epoller_event **pthis = epoller_event::pthis;
+
+	while (buff_pos < buff_len) {
+		meta = (const struct fanotify_event_metadata *)(buff.data() + buff_pos);
+		len  = buff_len - buff_pos;
+		if (!FAN_EVENT_OK(meta, len)) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"mismatched data read from file descriptor");
+			drop();
+			return -1;
+		}
+		if (meta->vers != FANOTIFY_METADATA_VERSION) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"mismatched metadata version %u", meta->vers);
+			drop();
+			return -1;
+		}
+		buff_pos += meta->event_len;
+
+		ev.meta = meta;
+		ev.fid  = 0;
+		ev.dfid = 0;
+		ev.name = 0;
+
+		// parse information records following the metadata
+		for (off = meta->metadata_len; off + sizeof *info <= meta->event_len; off += info->len) {
+			info = (const struct fanotify_event_info_header *)((const uint8_t *) meta + off);
+			if (!info->len || off + info->len > meta->event_len)
+				break;
+
+			switch (info->info_type) {
+			case FAN_EVENT_INFO_TYPE_FID:
+				ev.fid = (const struct fanotify_event_info_fid *) info;
+				break;
+#ifdef FAN_EVENT_INFO_TYPE_DFID_NAME
+			case FAN_EVENT_INFO_TYPE_DFID_NAME:
+				ev.dfid = (const struct fanotify_event_info_fid *) info;
+				handle  = (const struct file_handle *) ev.dfid->handle;
+				ev.name = (const char *) handle->f_handle + handle->handle_bytes;
+				break;
+			case FAN_EVENT_INFO_TYPE_DFID:
+				ev.dfid = (const struct fanotify_event_info_fid *) info;
+				break;
+#endif
+			default:
+				break; // not interested
+			}
+		}
+
+		// the carried file descriptor must be closed even if the epoller is destroyed meanwhile
+		efd = meta->fd;
+
+		if (meta->mask & FAN_Q_OVERFLOW) {
+			overflow_cnt++;
+			ELOG(ELOG_WARNING, DBG_PREFIX"event queue overflowed, some events have been lost");
+			ret = overflow(&ev);
+		} else
+			ret = fanhandler(&ev);
+
+		if (efd >= 0)
+			close(efd);
+
+		if (ret || !*pthis || fd == -1) {
+			// the rest is dispatched just before next epoll_wait (unless the fanotify epoller is gone)
+			if (*pthis && fd != -1 && buff_pos < buff_len && !queued) {
+				queued = true;
+				epoller->add_flush(this);
+			}
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+int fanepoller::flush(struct epoller *epoller, int *timeout)
+{
+	queued = false;
+	if (fd == -1)
+		return 0;
+
+	return dispatch();
+}
+
+void fanepoller::drop()
+{
+	const struct fanotify_event_metadata *meta;
+	ssize_t len;
+
+	// close file descriptors carried by events not dispatched yet
+	len = buff_len - buff_pos;
+	for (meta = (const struct fanotify_event_metadata *)(buff.data() + buff_pos); FAN_EVENT_OK(meta, len);
+	     meta = FAN_EVENT_NEXT(meta, len))
+		if (meta->fd >= 0)
+			close(meta->fd);
+
+	buff_pos = buff_len = 0;
+}
+
+int fanepoller::fanhandler(const struct fan_event *event)
+{
+	if (rcvr)
+		return rcvr->fanhandler(*this, event);
+	else if (_fanhandler)
+		return _fanhandler(*this, event);
+	else {
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: fanhandler");
+		return -1;
+	}
+}
+
+int fanepoller::overflow(const struct fan_event *event)
+{
+	if (rcvr)
+		return rcvr->overflow(*this, event);
+	else if (_overflow)
+		return _overflow(*this, event);
+	else
+		return fanhandler(event);
+}
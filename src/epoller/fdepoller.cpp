@@ -1,8 +1,10 @@
 #include <epoller/fdepoller.h>
+#include <epoller/log.h>
+#include <sys/sendfile.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
-#include <iostream>
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 
@@ -10,37 +12,43 @@
 
 int fdepoller::receiver::rx(fdepoller &sender, int len)
 {
-	std::cerr << DBG_PREFIX"unhandled event: rx" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: rx");
+	return -1;
+}
+
+int fdepoller::receiver::frame(fdepoller &sender, const uint8_t *data, size_t len)
+{
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: frame");
 	return -1;
 }
 
 int fdepoller::receiver::tx(fdepoller &sender, int len)
 {
-	std::cerr << DBG_PREFIX"unhandled event: tx" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: tx");
 	return -1;
 }
 
 int fdepoller::receiver::pri(fdepoller &sender)
 {
-	std::cerr << DBG_PREFIX"unhandled event: pri" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: pri");
 	return -1;
 }
 
 int fdepoller::receiver::hup(fdepoller &sender)
 {
-	std::cerr << DBG_PREFIX"unhandled event: hup" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: hup");
 	return -1;
 }
 
 int fdepoller::receiver::err(fdepoller &sender)
 {
-	std::cerr << DBG_PREFIX"unhandled event: err" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: err");
 	return -1;
 }
 
 int fdepoller::receiver::un(fdepoller &sender, int events)
 {
-	std::cerr << DBG_PREFIX"unhandled event: un" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: un");
 	return -1;
 }
 
@@ -62,7 +70,7 @@ bool fdepoller::init(int fd, size_t rxsize, size_t txsize, bool rxen, bool txen,
 
 	// check given file descriptor
 	if (fd < 0) {
-		std::cerr << DBG_PREFIX"gots wrong file descriptor" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"gots wrong file descriptor");
 		goto unwind;
 	}
 
@@ -81,7 +89,7 @@ bool fdepoller::init(int fd, size_t rxsize, size_t txsize, bool rxen, bool txen,
 	// initialize rx buffer
 	if (rxsize > 0) {
 		if (!linbuff_alloc(&rxbuff, rxsize)) {
-			std::cerr << DBG_PREFIX"rx buffer allocation failed" << std::endl;
+			ELOG(ELOG_ERROR, DBG_PREFIX"rx buffer allocation failed");
 			goto unwind;
 		}
 	} else
@@ -90,7 +98,7 @@ bool fdepoller::init(int fd, size_t rxsize, size_t txsize, bool rxen, bool txen,
 	// initialize tx buffer
 	if (txsize > 0) {
 		if (!linbuff_alloc(&txbuff, txsize)) {
-			std::cerr << DBG_PREFIX"tx buffer allocation failed" << std::endl;
+			ELOG(ELOG_ERROR, DBG_PREFIX"tx buffer allocation failed");
 			goto unwind_free_rxbuff;
 		}
 	} else
@@ -118,6 +126,20 @@ void fdepoller::cleanup()
 	if (fd == -1)
 		return; // already cleaned-up
 
+	// reset state of incomplete frame
+	if (frmr)
+		frmr->reset();
+
+	// drop corked data
+	if (tx_corked) {
+		if (epoller)
+			epoller->del_flush(this);
+		tx_corked = false;
+	}
+
+	// drop queued file regions
+	txfiles.clear();
+
 	// free tx buffer
 	if (txbuff.buff)
 		linbuff_free(&txbuff);
@@ -140,7 +162,7 @@ bool fdepoller::open(const std::string &pathname, int flags, size_t rxsize, size
 
 	int fd = ::open(pathname.c_str(), flags);
 	if (fd == -1) {
-		perror(DBG_PREFIX"opening file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"opening file failed");
 		return false;
 	}
 
@@ -177,7 +199,7 @@ bool fdepoller::enable(bool rxen, bool txen, bool prien)
 		event.events |= EPOLLPRI;
 	int ret = epoll_ctl(epoller->fd, EPOLL_CTL_ADD, fd, &event);
 	if (ret == -1) {
-		perror(DBG_PREFIX"adding file descriptor to parent epoller failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"adding file descriptor to parent epoller failed");
 		return false;
 	}
 
@@ -191,7 +213,7 @@ bool fdepoller::disable()
 		return true;
 
 	if (epoller->fd != -1 && epoll_ctl(epoller->fd, EPOLL_CTL_DEL, fd, NULL) == -1) {
-		perror(DBG_PREFIX"removing file descriptor from epoller failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"removing file descriptor from epoller failed");
 		return false;
 	}
 
@@ -206,7 +228,7 @@ bool fdepoller::disable_rx()
 
 	event.events &= ~EPOLLIN;
 	if (epoll_ctl(epoller->fd, EPOLL_CTL_MOD, fd, &event) == -1) {
-		perror(DBG_PREFIX"modifying within epoller (clear EPOLLIN) failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"modifying within epoller (clear EPOLLIN) failed");
 		return false;
 	} else
 		return true;
@@ -219,7 +241,7 @@ bool fdepoller::enable_rx()
 
 	event.events |= EPOLLIN;
 	if (epoll_ctl(epoller->fd, EPOLL_CTL_MOD, fd, &event) == -1) {
-		perror(DBG_PREFIX"modifying within epoller (set EPOLLIN) failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"modifying within epoller (set EPOLLIN) failed");
 		return false;
 	} else
 		return true;
@@ -232,7 +254,7 @@ bool fdepoller::disable_tx()
 
 	event.events &= ~EPOLLOUT;
 	if (epoll_ctl(epoller->fd, EPOLL_CTL_MOD, fd, &event) == -1) {
-		perror(DBG_PREFIX"modifying within epoller (clear EPOLLOUT) failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"modifying within epoller (clear EPOLLOUT) failed");
 		return false;
 	} else
 		return true;
@@ -245,7 +267,7 @@ bool fdepoller::enable_tx()
 
 	event.events |= EPOLLOUT;
 	if (epoll_ctl(epoller->fd, EPOLL_CTL_MOD, fd, &event) == -1) {
-		perror(DBG_PREFIX"modifying within epoller (set EPOLLOUT) failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"modifying within epoller (set EPOLLOUT) failed");
 		return false;
 	} else
 		return true;
@@ -258,7 +280,7 @@ bool fdepoller::disable_pri()
 
 	event.events &= ~EPOLLPRI;
 	if (epoll_ctl(epoller->fd, EPOLL_CTL_MOD, fd, &event) == -1) {
-		perror(DBG_PREFIX"modifying within epoller (clear EPOLLPRI) failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"modifying within epoller (clear EPOLLPRI) failed");
 		return false;
 	} else
 		return true;
@@ -271,7 +293,7 @@ bool fdepoller::enable_pri()
 
 	event.events |= EPOLLPRI;
 	if (epoll_ctl(epoller->fd, EPOLL_CTL_MOD, fd, &event) == -1) {
-		perror(DBG_PREFIX"modifying within epoller (set EPOLLPRI) failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"modifying within epoller (set EPOLLPRI) failed");
 		return false;
 	} else
 		return true;
@@ -281,13 +303,13 @@ bool fdepoller::set_flags(int flags)
 {
 	int ret = fcntl(fd, F_GETFL);
 	if (ret == -1) {
-		perror(DBG_PREFIX"getting file descriptor flags failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting file descriptor flags failed");
 		return false;
 	}
 
 	ret = fcntl(fd, F_SETFL, ret | flags);
 	if (ret == -1) {
-		perror(DBG_PREFIX"setting file descriptor flags failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting file descriptor flags failed");
 		return false;
 	}
 
@@ -298,13 +320,13 @@ bool fdepoller::clear_flags(int flags)
 {
 	int ret = fcntl(fd, F_GETFL);
 	if (ret == -1) {
-		perror(DBG_PREFIX"getting file descriptor flags failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting file descriptor flags failed");
 		return false;
 	}
 
 	ret = fcntl(fd, F_SETFL, ret & ~flags);
 	if (ret == -1) {
-		perror(DBG_PREFIX"setting file descriptor flags failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting file descriptor flags failed");
 		return false;
 	}
 
@@ -315,7 +337,7 @@ bool fdepoller::get_flags(int *flags)
 {
 	int ret = fcntl(fd, F_GETFL);
 	if (ret == -1) {
-		perror(DBG_PREFIX"getting file descriptor flags failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting file descriptor flags failed");
 		return false;
 	}
 
@@ -325,16 +347,76 @@ bool fdepoller::get_flags(int *flags)
 
 int fdepoller::rx(int len)
 {
+	if (frmr && len > 0)
+		return rx_frames();
+
 	if (rcvr)
 		return rcvr->rx(*this, len);
 	else if (_rx)
 		return _rx(*this, len);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: rx" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: rx");
 		return -1;
 	}
 }
 
+int fdepoller::frame(const uint8_t *data, size_t len)
+{
+	if (rcvr)
+		return rcvr->frame(*this, data, len);
+	else if (_frame)
+		return _frame(*this, data, len);
+	else {
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: frame");
+		return -1;
+	}
+}
+
+int fdepoller::rx_frames()
+{
+	int ret;
+	ssize_t flen;
+	size_t off, plen, need;
+	struct epoller_event **pthis = epoller_event::pthis;
+
+	// deliver whole frames (delivered frame is consumed even if the loop is exited)
+	while ((flen = frmr->next(LINBUFF_RD_PTR(&rxbuff), linbuff_tord(&rxbuff), &off, &plen)) > 0) {
+		ret = frame(LINBUFF_RD_PTR(&rxbuff) + off, plen);
+		if ((pthis && !*pthis) || fd == -1)
+			return ret;
+		linbuff_skip(&rxbuff, flen);
+		frmr->consume(flen);
+		if (ret)
+			return ret;
+	}
+
+	if (flen < 0) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"framing failed (malformed frame or frame too large)");
+		frmr->reset();
+		return rx(-1);
+	}
+
+	// make room for incomplete frame
+	need = frmr->need;
+	if (!linbuff_tord(&rxbuff)) {
+		linbuff_clear(&rxbuff);
+
+	} else if (need ? rxbuff.rdix + need > rxbuff.size : !linbuff_towr(&rxbuff)) {
+		linbuff_compact(&rxbuff);
+
+		if (!need && !linbuff_towr(&rxbuff))
+			// unknown size of incomplete frame, so double the buffer
+			need = std::min(2 * rxbuff.size, frmr->max_size);
+
+		if (need > rxbuff.size && !linbuff_realloc(&rxbuff, need)) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"rx buffer reallocation failed");
+			return rx(-1);
+		}
+	}
+
+	return 0;
+}
+
 int fdepoller::tx(int len)
 {
 	if (rcvr)
@@ -342,7 +424,7 @@ int fdepoller::tx(int len)
 	else if (_tx)
 		return _tx(*this, len);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: tx" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: tx");
 		return -1;
 	}
 }
@@ -354,7 +436,7 @@ int fdepoller::pri()
 	else if (_pri)
 		return _pri(*this);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: pri" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: pri");
 		return -1;
 	}
 }
@@ -366,7 +448,7 @@ int fdepoller::hup()
 	else if (_hup)
 		return _hup(*this);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: hup" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: hup");
 		return -1;
 	}
 }
@@ -378,7 +460,7 @@ int fdepoller::err()
 	else if (_err)
 		return _err(*this);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: err" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: err");
 		return -1;
 	}
 }
@@ -390,7 +472,7 @@ int fdepoller::un(int events)
 	else if (_un)
 		return _un(*this, events);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: un" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: un");
 		return -1;
 	}
 }
@@ -410,11 +492,11 @@ int fdepoller::epoll_in()
 	int ret = read(fd, LINBUFF_WR_PTR(&rxbuff), linbuff_towr(&rxbuff));
 
 	if (ret < -1) {
-		perror(DBG_PREFIX"reading from file descriptor failed (unexpected retvalue)");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"reading from file descriptor failed (unexpected retvalue)");
 		return rx(-1);
 
 	} else if (ret == -1) {
-		perror(DBG_PREFIX"reading from file descriptor failed");
+		ELOG_ERRNO(errno == EAGAIN ? ELOG_DEBUG : ELOG_ERROR, DBG_PREFIX"reading from file descriptor failed");
 		return rx(-1);
 
 	} else if (ret == 0) {
@@ -422,27 +504,74 @@ int fdepoller::epoll_in()
 
 	} else {
 		linbuff_forward(&rxbuff, ret);
+		rx_charge(ret);
 		return rx(ret);
 	}
 }
 
+int fdepoller::epoll_in_budget()
+{
+	int ret;
+	size_t towr, bytes;
+	unsigned int reads = 0;
+	struct epoller_event **pthis = epoller_event::pthis;
+
+	rx_event_bytes = 0;
+	for (;;) {
+		towr  = linbuff_towr(&rxbuff);
+		bytes = rx_event_bytes;
+
+		ret = epoll_in();
+		if (ret || !*pthis || fd == -1)
+			return ret;
+
+		if (!towr || rx_event_bytes - bytes < towr)
+			break; // file descriptor drained (or nothing to read into)
+
+		if (++reads >= rx_budget_reads || (rx_budget_bytes && rx_event_bytes >= rx_budget_bytes) ||
+		    (epoller->rx_budget && !epoller->rx_budget_left)) {
+			// budget exhausted, remaining data will be received in next loop iteration
+			if (rx_budget_reads > 1 || rx_budget_bytes || epoller->rx_budget)
+				epoller->rx_deferred++;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+void fdepoller::rx_charge(size_t len)
+{
+	rx_event_bytes += len;
+
+	if (epoller->rx_budget)
+		epoller->rx_budget_left -= std::min(len, epoller->rx_budget_left);
+}
+
 int fdepoller::epoll_out()
 {
-	int ret = write(fd, LINBUFF_RD_PTR(&txbuff), linbuff_tord(&txbuff));
+	// corked data are written by flush, which enables transmitting again if they are not written at once
+	if (tx_corked)
+		return disable_tx() ? 0 : -1;
+
+	if (!txfiles.empty() && !txfiles.front().before)
+		return epoll_out_file();
+
+	int ret = write(fd, LINBUFF_RD_PTR(&txbuff), tx_chunk());
 
 	if (ret < -1) {
-		perror(DBG_PREFIX"writing to file descriptor failed (unexpected retvalue)");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"writing to file descriptor failed (unexpected retvalue)");
 		return tx(-1);
 
 	} else if (ret == -1) {
-		perror(DBG_PREFIX"writing to file descriptor failed");
+		ELOG_ERRNO(errno == EAGAIN ? ELOG_DEBUG : ELOG_ERROR, DBG_PREFIX"writing to file descriptor failed");
 		return tx(-1);
 
 	} else if (ret == 0) {
 		return tx(0);
 
 	} else {
-		linbuff_skip(&txbuff, ret);
+		tx_skip(ret);
 		return tx(ret);
 	}
 }
@@ -471,7 +600,31 @@ ssize_t fdepoller::write_stream(const void *buff, size_t len)
 {
 	ssize_t ret = 0;
 
-	if (!linbuff_tord(&txbuff)) {
+	if (tx_cork) {
+		// corked mode, so just write data to linear buffer and let them be flushed later
+
+		if (linbuff_towr(&txbuff) < len)
+			linbuff_compact(&txbuff);
+		ret = linbuff_write(&txbuff, (uint8_t *)buff, len);
+
+		if (tx_cork_bytes && linbuff_tord(&txbuff) >= tx_cork_bytes) {
+			// too many corked data, flush them immediately
+			if (tx_corked) {
+				epoller->del_flush(this);
+				tx_corked = false;
+			}
+			if (tx_uncork() == -1)
+				return -1;
+		} else if (!tx_corked && tx_chunk()) {
+			tx_corked = true;
+			clock_gettime(CLOCK_MONOTONIC, &tx_cork_time);
+			epoller->add_flush(this);
+		}
+
+		return ret;
+	}
+
+	if (!tx_pending()) {
 		// linear buffer is empty, so try to write data directly to file descriptor
 
 		ret = write(fd, buff, len);
@@ -489,11 +642,15 @@ ssize_t fdepoller::write_stream(const void *buff, size_t len)
 			return -1;
 	}
 
+	// make room for remaining data if needed
+	if (linbuff_towr(&txbuff) < len - ret)
+		linbuff_compact(&txbuff);
+
 	// write remaining data to linear buffer
 	ret += linbuff_write(&txbuff, (uint8_t *)buff + ret, len - ret);
 
 	// enable transmitting if there are pending data in linear buffer
-	if (linbuff_tord(&txbuff))
+	if (tx_pending())
 		enable_tx();
 
 	// return number of written bytes
@@ -502,12 +659,214 @@ ssize_t fdepoller::write_stream(const void *buff, size_t len)
 
 ssize_t fdepoller::write_dgram(const void *buff, size_t len)
 {
+	if (linbuff_towr(&txbuff) < len)
+		linbuff_compact(&txbuff);
+
 	if (linbuff_towr(&txbuff) < len)
 		return 0;
 
 	return write_stream(buff, len) == (ssize_t) len ? len : -1;
 }
 
+ssize_t fdepoller::tx_uncork()
+{
+	ssize_t ret = 0;
+	size_t len = tx_chunk();
+
+	if (len) {
+		ret = write(fd, LINBUFF_RD_PTR(&txbuff), len);
+		if (ret > 0)
+			// something written
+			tx_skip(ret);
+		else if (ret == 0)
+			// nothing written
+			;
+		else if (errno == EWOULDBLOCK)
+			// fd buffer full
+			ret = 0;
+		else
+			// fd error
+			return -1;
+	}
+
+	// enable transmitting if there are still pending data
+	if (tx_pending())
+		enable_tx();
+
+	return ret;
+}
+
+int fdepoller::flush(struct epoller *epoller, int *timeout)
+{
+	struct timespec now;
+	long elapsed;
+
+	tx_corked = false;
+	if (fd == -1)
+		return 0;
+
+	if (tx_cork_delay > 0) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed = (now.tv_sec - tx_cork_time.tv_sec) * 1000 + (now.tv_nsec - tx_cork_time.tv_nsec) / 1000000;
+		if (elapsed < tx_cork_delay) {
+			// keep data corked for remaining time
+			tx_corked = true;
+			epoller->add_flush(this);
+			if (*timeout < 0 || *timeout > tx_cork_delay - elapsed)
+				*timeout = tx_cork_delay - elapsed;
+			return 0;
+		}
+	}
+
+	if (tx_uncork() == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"flushing corked data failed");
+		return tx(-1);
+	}
+
+	return 0;
+}
+
+bool fdepoller::detach()
+{
+	if (fd == -1 || !epoller)
+		return false;
+
+	// remove file descriptor from parent epoller, remember whether it was there
+	attach_enabled = enabled;
+	if (!disable())
+		return false;
+
+	// corked data stay in tx buffer, they are flushed by the new parent epoller
+	if (tx_corked)
+		epoller->del_flush(this);
+
+	// stop the handler, if running
+	if (pthis) {
+		*pthis = 0;
+		pthis  = 0;
+	}
+
+	epoller = 0;
+	return true;
+}
+
+bool fdepoller::attach(struct epoller *epoller)
+{
+	if (fd == -1 || this->epoller)
+		return false;
+
+	this->epoller = epoller;
+
+	if (attach_enabled) {
+		event.data.ptr = this;
+		if (epoll_ctl(epoller->fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"adding file descriptor to new parent epoller failed");
+			return false;
+		}
+		enabled = true;
+	}
+
+	if (tx_corked)
+		epoller->add_flush(this);
+
+	return true;
+}
+
+ssize_t fdepoller::write_file(int fd, off_t offset, size_t len)
+{
+	ssize_t ret = 0;
+	struct txfile file;
+
+	if (!tx_pending()) {
+		// nothing is pending, so try to transmit the region directly to file descriptor
+
+		ret = send_file(fd, &offset, len);
+		if (ret > 0)
+			// something transmitted
+			;
+		else if (ret == 0)
+			// end of file reached
+			return 0;
+		else if (errno == EWOULDBLOCK)
+			// fd buffer full
+			ret = 0;
+		else
+			// fd error
+			return -1;
+	}
+
+	if ((size_t) ret == len)
+		return ret;
+
+	// queue remaining part of the region behind the data pending in linear buffer
+	file.fd     = fd;
+	file.offset = offset;
+	file.len    = len - ret;
+	file.before = linbuff_tord(&txbuff);
+	for (std::deque<txfile>::const_iterator it = txfiles.begin(); it != txfiles.end(); ++it)
+		file.before -= (*it).before;
+	txfiles.push_back(file);
+
+	enable_tx();
+
+	return ret;
+}
+
+ssize_t fdepoller::send_file(int in_fd, off_t *offset, size_t len)
+{
+	loff_t off = *offset;
+	ssize_t ret = copy_file_range(in_fd, &off, fd, NULL, len, 0);
+
+	if (ret == -1 && (errno == EINVAL || errno == EXDEV || errno == EBADF || errno == EOPNOTSUPP))
+		// not a regular file
+		return sendfile(fd, in_fd, offset, len);
+
+	if (ret > 0)
+		*offset = off;
+
+	return ret;
+}
+
+int fdepoller::epoll_out_file()
+{
+	struct txfile &file = txfiles.front();
+	ssize_t ret = send_file(file.fd, &file.offset, file.len);
+
+	if (ret == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"transmitting file region failed");
+		return tx(-1);
+
+	} else if (ret == 0) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"transmitting file region failed (unexpected end of file)");
+		txfiles.pop_front();
+		return tx(-1);
+
+	} else {
+		file.len -= ret;
+		if (!file.len)
+			txfiles.pop_front();
+		return tx(ret);
+	}
+}
+
+size_t fdepoller::tx_chunk() const
+{
+	size_t len = linbuff_tord(&txbuff);
+
+	if (!txfiles.empty() && txfiles.front().before < len)
+		len = txfiles.front().before;
+
+	return len;
+}
+
+void fdepoller::tx_skip(size_t len)
+{
+	linbuff_skip(&txbuff, len);
+
+	if (!txfiles.empty())
+		txfiles.front().before -= len;
+}
+
 int fdepoller::handler(struct epoller *epoller, struct epoll_event *revent)
 {
 	int ret;
@@ -519,10 +878,15 @@ int fdepoller::handler(struct epoller *epoller, struct epoll_event *revent)
 
 	if (revent->events & EPOLLIN) {
 		revent->events &= ~EPOLLIN;
-		epoll_in_cnt++;
-		ret = epoll_in();
-		if (ret || !*pthis || fd == -1)
-			return ret;
+		if (epoller->rx_budget && !epoller->rx_budget_left) {
+			// global budget exhausted, defer reception to next loop iteration
+			epoller->rx_deferred++;
+		} else {
+			epoll_in_cnt++;
+			ret = epoll_in_budget();
+			if (ret || !*pthis || fd == -1)
+				return ret;
+		}
 	}
 
 	if (revent->events & EPOLLOUT) {
@@ -571,8 +935,9 @@ int fdepoller::handler(struct epoller *epoller, struct epoll_event *revent)
 			return -1;
 	}
 
-	if (linbuff_tord(&txbuff)) {
-		if (enabled && tx_auto_enable && !enable_tx())
+	if (tx_pending()) {
+		// corked data are written by flush, not by EPOLLOUT
+		if (enabled && tx_auto_enable && !tx_corked && !enable_tx())
 			return -1;
 	} else {
 		if (enabled && tx_auto_disable && !disable_tx())
@@ -0,0 +1,245 @@
+#include <epoller/fdrelay.h>
+#include <epoller/log.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <cstdio>
+
+#define DBG_PREFIX "fdrelay: "
+
+int fdrelay::receiver::done(fdrelay &sender, int error)
+{
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: done");
+	return -1;
+}
+
+bool fdrelay::init(fdepoller *a, fdepoller *b, size_t chunk, int pipe_size)
+{
+	// check state
+	if (active || dirs[0].pfd[0] != -1) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"already initialized");
+		return false;
+	}
+
+	// check epollers
+	if (!a || !b || a == b || a->fd == -1 || b->fd == -1) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"gots wrong epollers");
+		return false;
+	}
+
+	// create intermediate pipes
+	for (int i = 0; i < 2; ++i) {
+		dirs[i] = direction();
+		if (pipe2(dirs[i].pfd, O_NONBLOCK | O_CLOEXEC) == -1) {
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"creating pipe failed");
+			goto unwind;
+		}
+		if (pipe_size > 0 && fcntl(dirs[i].pfd[1], F_SETPIPE_SZ, pipe_size) == -1) {
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting pipe size failed");
+			goto unwind;
+		}
+	}
+
+	dirs[0].src = dirs[1].dst = a;
+	dirs[1].src = dirs[0].dst = b;
+	this->chunk = chunk;
+
+	// take control over both epollers
+	for (int i = 0; i < 2; ++i) {
+		fdepoller *ep = dirs[i].src;
+
+		if (!ep->set_flags(O_NONBLOCK))
+			goto unwind;
+
+		ep->rcvr            = this;
+		ep->rx_auto_enable  = false;
+		ep->rx_auto_disable = false;
+		ep->tx_auto_enable  = false;
+		ep->tx_auto_disable = false;
+
+		if (ep->enabled) {
+			if (!ep->disable_tx() || !ep->disable_pri() || !ep->enable_rx())
+				goto unwind;
+		} else if (!ep->enable(true, false, false))
+			goto unwind;
+	}
+
+	active = true;
+	return true;
+
+unwind:
+	cleanup();
+	return false;
+}
+
+void fdrelay::cleanup()
+{
+	active = false;
+
+	for (int i = 0; i < 2; ++i) {
+		if (dirs[i].src && dirs[i].src->rcvr == this)
+			dirs[i].src->rcvr = 0;
+		if (dirs[i].pfd[0] != -1)
+			close(dirs[i].pfd[0]);
+		if (dirs[i].pfd[1] != -1)
+			close(dirs[i].pfd[1]);
+		dirs[i] = direction();
+	}
+}
+
+void fdrelay::stop()
+{
+	active = false;
+
+	for (int i = 0; i < 2; ++i)
+		if (dirs[i].src->enabled)
+			dirs[i].src->disable();
+}
+
+int fdrelay::done(int error)
+{
+	if (rcvr)
+		return rcvr->done(*this, error);
+	else if (_done)
+		return _done(*this, error);
+	else {
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: done");
+		return -1;
+	}
+}
+
+int fdrelay::pump(struct direction *dir)
+{
+	ssize_t ret;
+	bool again;
+
+	// hung-up source is not in epoller any more, so it is drained here until end of file (or EAGAIN)
+	for (;;) {
+		again = false;
+
+		if (!dir->eof) {
+			ret = splice(dir->src->fd, NULL, dir->pfd[1], NULL, chunk, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+			if (ret == -1) {
+				if (errno != EAGAIN) {
+					ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"splicing from source failed");
+					return -1;
+				}
+				again = true;
+			} else if (ret == 0)
+				dir->eof = true;
+			else
+				dir->pending += ret;
+		}
+
+		if ((ret = flush(dir)) || !dir->hup || dir->eof || dir->pending || again)
+			return ret;
+	}
+}
+
+int fdrelay::flush(struct direction *dir)
+{
+	ssize_t ret;
+
+	if (dir->shut)
+		return dirs[0].shut && dirs[1].shut ? 1 : 0;
+
+	// move data from pipe to sink
+	while (dir->pending) {
+		ret = splice(dir->pfd[0], NULL, dir->dst->fd, NULL, dir->pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (ret == -1) {
+			if (errno == EAGAIN)
+				break;
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"splicing to sink failed");
+			return -1;
+		}
+		dir->pending -= ret;
+		dir->bytes   += ret;
+	}
+
+	// sink is blocked, so stop reading from source until sink is writable
+	if (dir->pending) {
+		if (dir->src->enabled && !dir->src->disable_rx())
+			return -1;
+		if (dir->dst->enabled && !dir->dst->enable_tx())
+			return -1;
+		return 0;
+	}
+
+	if (dir->dst->enabled && !dir->dst->disable_tx())
+		return -1;
+
+	// source has still some data
+	if (!dir->eof) {
+		if (dir->hup)
+			return 0; // source is not in epoller any more, it is drained by pump
+		if (dir->src->enabled && !dir->src->enable_rx())
+			return -1;
+		return 0;
+	}
+
+	// source is at the end, so shutdown write side of sink
+	if (dir->src->enabled && !dir->src->disable_rx())
+		return -1;
+	if (::shutdown(dir->dst->fd, SHUT_WR) == -1 && errno != ENOTSOCK && errno != ENOTCONN) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"shutdowning sink failed");
+		return -1;
+	}
+	dir->shut = true;
+
+	return dirs[0].shut && dirs[1].shut ? 1 : 0;
+}
+
+int fdrelay::enter(fdepoller &sender, struct epoll_event *revent)
+{
+	int ret = 0;
+	struct direction *in  = &sender == dirs[0].src ? &dirs[0] : &dirs[1];
+	struct direction *out = &sender == dirs[0].dst ? &dirs[0] : &dirs[1];
+
+	if (!active) {
+		revent->events = 0;
+		return 0;
+	}
+
+	if (revent->events & EPOLLERR) {
+		int error = 0;
+		socklen_t len = sizeof error;
+		revent->events = 0;
+		if (getsockopt(sender.fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error)
+			errno = error;
+		ret = -1;
+
+	} else if (revent->events & EPOLLHUP) {
+		revent->events = 0;
+
+		// nothing can be written to hung-up epoller any more
+		out->eof  = true;
+		out->shut = true;
+		if (out->src->enabled && !out->src->disable_rx())
+			ret = -1;
+
+		// remaining data are read without epoller
+		in->hup = true;
+		if (!ret && !sender.disable())
+			ret = -1;
+		if (!ret)
+			ret = pump(in);
+
+	} else {
+		if (revent->events & EPOLLOUT) {
+			revent->events &= ~EPOLLOUT;
+			ret = out->hup ? pump(out) : flush(out);
+		}
+
+		if (!ret && (revent->events & EPOLLIN)) {
+			revent->events &= ~EPOLLIN;
+			ret = pump(in);
+		}
+	}
+
+	if (!ret)
+		return 0;
+
+	stop();
+	return done(ret > 0 ? 0 : -1);
+}
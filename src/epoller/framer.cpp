@@ -0,0 +1,218 @@
+#include <epoller/framer.h>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/// @brief Maximum length of LEB128 varint prefix (enough for 64 bits).
+#define VARINT_MAX_LEN 10
+
+typedef void (*find_all_fn)(const uint8_t *data, size_t from, size_t to, uint8_t byte, std::vector<size_t> &pos);
+
+static void find_all_scalar(const uint8_t *data, size_t from, size_t to, uint8_t byte, std::vector<size_t> &pos)
+{
+	const uint8_t *p = data + from, *end = data + to;
+
+	while (p < end && (p = (const uint8_t *) memchr(p, byte, end - p))) {
+		pos.push_back(p - data);
+		++p;
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2")))
+static void find_all_sse2(const uint8_t *data, size_t from, size_t to, uint8_t byte, std::vector<size_t> &pos)
+{
+	const __m128i v = _mm_set1_epi8(byte);
+	size_t i = from;
+	unsigned int m;
+
+	for (; i + 16 <= to; i += 16) {
+		m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (data + i)), v));
+		while (m) {
+			pos.push_back(i + __builtin_ctz(m));
+			m &= m - 1;
+		}
+	}
+
+	for (; i < to; ++i)
+		if (data[i] == byte)
+			pos.push_back(i);
+}
+
+__attribute__((target("avx2")))
+static void find_all_avx2(const uint8_t *data, size_t from, size_t to, uint8_t byte, std::vector<size_t> &pos)
+{
+	const __m256i v = _mm256_set1_epi8(byte);
+	size_t i = from;
+	unsigned int m;
+
+	for (; i + 32 <= to; i += 32) {
+		m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (data + i)), v));
+		while (m) {
+			pos.push_back(i + __builtin_ctz(m));
+			m &= m - 1;
+		}
+	}
+
+	find_all_sse2(data, i, to, byte, pos);
+}
+
+#endif
+
+static find_all_fn find_all_select()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return find_all_avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return find_all_sse2;
+#endif
+	return find_all_scalar;
+}
+
+void framer::find_all(const uint8_t *data, size_t from, size_t to, uint8_t byte, std::vector<size_t> &pos)
+{
+	static const find_all_fn fn = find_all_select();
+
+	fn(data, from, to, byte, pos);
+}
+
+void framer::init_fixed(size_t size)
+{
+	this->mode     = FIXED;
+	this->size     = size;
+	this->max_size = size;
+	reset();
+}
+
+void framer::init_length(size_t prefix, bool big_endian, bool inclusive, size_t max_size, bool strip)
+{
+	this->mode       = LENGTH;
+	this->size       = prefix;
+	this->big_endian = big_endian;
+	this->inclusive  = inclusive;
+	this->max_size   = max_size;
+	this->strip      = strip;
+	reset();
+}
+
+void framer::init_delimiter(const std::string &delimiter, size_t max_size, bool strip)
+{
+	this->mode      = DELIMITER;
+	this->delimiter = delimiter;
+	this->max_size  = max_size;
+	this->strip     = strip;
+	reset();
+}
+
+ssize_t framer::next(const uint8_t *data, size_t len, size_t *off, size_t *plen)
+{
+	uint64_t flen = 0;
+	size_t hlen = 0, dlen, last, n = 0;
+
+	switch (mode) {
+
+	case FIXED:
+		need = size;
+		if (len < size)
+			return 0;
+		*off  = 0;
+		*plen = size;
+		return size;
+
+	case LENGTH:
+		if (size == 0) {
+			// LEB128 varint prefix
+			for (;;) {
+				if (hlen == len)
+					return 0;
+				if (hlen == VARINT_MAX_LEN)
+					return -1;
+				flen |= (uint64_t) (data[hlen] & 0x7f) << (7 * hlen);
+				if (flen > max_size)
+					return -1;
+				if (!(data[hlen++] & 0x80))
+					break;
+			}
+		} else {
+			// fixed-size prefix
+			hlen = size;
+			if (len < hlen)
+				return 0;
+			for (size_t i = 0; i < hlen; ++i)
+				if (big_endian)
+					flen = (flen << 8) | data[i];
+				else
+					flen |= (uint64_t) data[i] << (8 * i);
+		}
+
+		if (!inclusive)
+			flen += hlen;
+		else if (flen < hlen)
+			return -1;
+		if (flen > max_size)
+			return -1;
+
+		need = flen;
+		if (len < flen)
+			return 0;
+		*off  = strip ? hlen : 0;
+		*plen = strip ? flen - hlen : flen;
+		return flen;
+
+	case DELIMITER:
+		dlen = delimiter.size();
+		if (!dlen)
+			return -1;
+
+		if (index_pos == index.size()) {
+			// scan all new bytes for delimiters at once
+			index.clear();
+			index_pos  = 0;
+			index_base = 0;
+
+			if (len >= dlen && len - dlen + 1 > scan) {
+				find_all(data, scan, len - dlen + 1, delimiter[0], index);
+
+				// keep only whole non-overlapping delimiters and store ends of frames
+				last = 0;
+				for (size_t i = 0; i < index.size(); ++i)
+					if (index[i] >= last && (dlen == 1 || !memcmp(data + index[i] + 1, delimiter.data() + 1, dlen - 1)))
+						index[n++] = last = index[i] + dlen;
+				index.resize(n);
+
+				scan = len - dlen + 1;
+			}
+		}
+
+		if (index_pos == index.size()) {
+			if (len >= max_size)
+				return -1;
+			return 0;
+		}
+
+		flen = index[index_pos] - index_base;
+		if (flen > max_size)
+			return -1;
+		*off  = 0;
+		*plen = strip ? flen - dlen : flen;
+		return flen;
+	}
+
+	return -1;
+}
+
+void framer::consume(size_t flen)
+{
+	if (mode != DELIMITER) {
+		reset();
+		return;
+	}
+
+	index_pos++;
+	index_base += flen;
+	scan        = scan > flen ? scan - flen : 0;
+}
@@ -1,56 +1,77 @@
 #include <epoller/gepoller.h>
+#include <epoller/log.h>
 #include <errno.h>
 #include <cstdio>
 #include <cstring>
-#include <iostream>
+#include <ctime>
 
 #define DBG_PREFIX "gepoller: "
 
+/// @brief Gets monotonic time in milliseconds.
+static inline uint64_t monotonic_msec()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
 #ifndef GEPOLLER_EVENTS_COMPATIBLE
 	#define GEPOLLER_EVENTS_COMPATIBLE 1
 #endif
 
 int gepoller_event::handler(struct epoller *epoller, struct epoll_event *revent)
 {
-	if (!gfd) {
-		std::cerr << DBG_PREFIX"null glib file descriptor" << std::endl;
-		return false;
+	if (fd == -1) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"event of free glib file descriptor slot");
+		return -1;
 	}
 
-	gfd->revents = events_epoll2glib(revent->events);
+	revents |= events_epoll2glib(revent->events);
 
 	return 0;
 }
 
 bool gepoller_event::add_to_epoller(struct epoller *epoller)
 {
-	if (!gfd) {
-		std::cerr << DBG_PREFIX"null glib file descriptor" << std::endl;
-		return false;
-	}
-
 	memset(&event, 0, sizeof event);
 	event.data.ptr = this;
-	event.events = events_glib2epoll(gfd->events);
-	int ret = epoll_ctl(epoller->fd, EPOLL_CTL_ADD, gfd->fd, &event);
+	event.events = events_glib2epoll(events);
+	int ret = epoll_ctl(epoller->fd, EPOLL_CTL_ADD, fd, &event);
 	if (ret == -1) {
-		perror(DBG_PREFIX"adding file descriptor to parent epoller failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"adding file descriptor to parent epoller failed");
 		return false;
 	}
 
 	return true;
 }
 
-bool gepoller_event::del_from_epoller(struct epoller *epoller)
+bool gepoller_event::mod_in_epoller(struct epoller *epoller)
 {
-	if (!gfd) {
-		std::cerr << DBG_PREFIX"null glib file descriptor" << std::endl;
+	event.events = events_glib2epoll(events);
+	int ret = epoll_ctl(epoller->fd, EPOLL_CTL_MOD, fd, &event);
+	if (ret == -1 && errno == ENOENT) {
+		// file descriptor has been closed and reopened meanwhile, so it was removed from epoll
+		ret = epoll_ctl(epoller->fd, EPOLL_CTL_ADD, fd, &event);
+	}
+	if (ret == -1 && errno == EBADF) {
+		// file descriptor has been closed and not reopened, glib stops polling it soon
+		return true;
+	}
+	if (ret == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"modifying file descriptor within parent epoller failed");
 		return false;
 	}
 
-	int ret = epoll_ctl(epoller->fd, EPOLL_CTL_DEL, gfd->fd, NULL);
-	if (ret == -1) {
-		perror(DBG_PREFIX"removing file descriptor from parent epoller failed");
+	return true;
+}
+
+bool gepoller_event::del_from_epoller(struct epoller *epoller)
+{
+	int ret = epoll_ctl(epoller->fd, EPOLL_CTL_DEL, fd, NULL);
+	if (ret == -1 && errno != EBADF && errno != ENOENT) {
+		// closed file descriptor has been already removed from epoll
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"removing file descriptor from parent epoller failed");
 		return false;
 	}
 
@@ -99,33 +120,26 @@ int gepoller_event::events_epoll2glib(int events)
 
 bool gepoller::loop()
 {
-	int r, ret, to, g_priority, g_timeout, gfds_n;
-	bool gevents_added = false;
+	int r, ret, to, to_computed, to_resync, g_priority, g_timeout, gfds_n;
 
 	loop_exit = 0;
 	while (!loop_exit) {
 
 		// glib stuff
 		if (!g_main_context_acquire(context)) {
-			std::cerr << DBG_PREFIX"acquiring glib context failed" << std::endl;
+			ELOG(ELOG_ERROR, DBG_PREFIX"acquiring glib context failed");
 			loop_exit = -1;
 			break;
 		}
 		if (g_main_context_prepare(context, &g_priority))
 			g_main_context_dispatch(context);
-		gfds_n = g_main_context_query(context, g_priority, &g_timeout, gfds, gevents_size);
+		gfds_n = query_gfds(g_priority, &g_timeout);
 		g_main_context_release(context);
-		if (gfds_n > (int) gevents_size) {
-			std::cerr << DBG_PREFIX"not enough place to store glib file descriptors" << std::endl;
-			loop_exit = -1;
-			break;
-		}
-		if (!add_gevents_to_epoller(gfds_n)) {
-			std::cerr << DBG_PREFIX"adding glib events to epoller failed" << std::endl;
+		if (!sync_gevents(gfds_n)) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"synchronizing glib events with epoller failed");
 			loop_exit = -1;
 			break;
 		}
-		gevents_added = true;
 
 		// call pre-epoll handler
 		if (pre_epoll_handler) {
@@ -134,7 +148,7 @@ bool gepoller::loop()
 				loop_exit = 1;
 				break;
 			} else if (r < 0) {
-				std::cerr << DBG_PREFIX"pre_epoll_handler announces exit with error" << std::endl;
+				ELOG(ELOG_ERROR, DBG_PREFIX"pre_epoll_handler announces exit with error");
 				loop_exit = -1;
 				break;
 			}
@@ -150,6 +164,28 @@ bool gepoller::loop()
 		else
 			to = std::min(timeout, g_timeout);
 
+		// flush events
+		to_computed = to;
+		r = flush(&to);
+		if (r > 0) {
+			loop_exit = 1;
+			break;
+		} else if (r < 0) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"flushed event announces exit with error");
+			loop_exit = -1;
+			break;
+		}
+
+		// do not block if some reception has been deferred
+		if (rx_deferred)
+			to = 0;
+		rx_deferred = 0;
+
+		// wake up for the next full resynchronization of glib file descriptors
+		to_resync = resync_timeout();
+		if (to_resync >= 0 && (to < 0 || to_resync < to))
+			to = to_resync;
+
 		// call epoll wait
 		do {
 			ret = epoll_wait(fd, revents, revents_size, to);
@@ -162,7 +198,7 @@ bool gepoller::loop()
 				loop_exit = 1;
 				break;
 			} else if (r < 0) {
-				std::cerr << DBG_PREFIX"post_epoll_handler announces exit with error" << std::endl;
+				ELOG(ELOG_ERROR, DBG_PREFIX"post_epoll_handler announces exit with error");
 				loop_exit = -1;
 				break;
 			}
@@ -171,20 +207,20 @@ bool gepoller::loop()
 		if (ret == -1) {
 
 			// error
-			perror(DBG_PREFIX"epoll waiting failed");
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"epoll waiting failed");
 			loop_exit = -1;
 			break;
 
 		} else if (ret == 0) {
 
-			// call timeout handler
-			if (timeout_handler) {
+			// call timeout handler (unless epoll timeout has been lowered by deferred reception or flushed event)
+			if (timeout_handler && to == to_computed) {
 				r = timeout_handler(this);
 				if (r > 0) {
 					loop_exit = 1;
 					break;
 				} else if (r < 0) {
-					std::cerr << DBG_PREFIX"timeout_handler announces exit with error" << std::endl;
+					ELOG(ELOG_ERROR, DBG_PREFIX"timeout_handler announces exit with error");
 					loop_exit = -1;
 					break;
 				}
@@ -192,84 +228,28 @@ bool gepoller::loop()
 
 		} else {
 
-			// call revents handler
-			if (revents_handler) {
-				r = revents_handler(this, revents, ret);
-				if (r > 0) {
-					loop_exit = 1;
-					break;
-				} else if (r < 0) {
-					std::cerr << DBG_PREFIX"revents_handler announces exit with error" << std::endl;
-					loop_exit = -1;
-					break;
-				}
-			}
-
-			// set pthis member of each event
-			for (int i = 0; i < ret; ++i) {
-				struct epoller_event *ev = (struct epoller_event*) revents[i].data.ptr;
-				if (ev)
-					ev->pthis = (struct epoller_event **) &revents[i].data.ptr;
-				else {
-					std::cerr << DBG_PREFIX"unexpected null pointer to epoll event" << std::endl;
-					loop_exit = -1;
-					break;
-				}
-			}
-			if (loop_exit)
-				break;
-
-			// call handler of each event
-			for (int i = 0; i < ret; ++i)
-				if (revents[i].events) {
-					struct epoller_event *ev = (struct epoller_event*) revents[i].data.ptr;
-					if (ev) {
-						r = ev->handler(this, &revents[i]);
-						if (r)
-							break;
-					}
-				}
-
-			// clear pthis member of each event
-			for (int i = 0; i < ret; ++i) {
-				struct epoller_event *ev = (struct epoller_event*) revents[i].data.ptr;
-				if (ev)
-					ev->pthis = 0;
-			}
-
-			// exit if demanded
-			if (r > 0) {
-				loop_exit = 1;
+			// dispatch returned events
+			if (dispatch(ret))
 				break;
-			} else if (r < 0) {
-				std::cerr << DBG_PREFIX"epoll event handler announces exit with error" << std::endl;
-				loop_exit = -1;
-				break;
-			}
 
 		}
 
 		// glib stuff
-		if (!del_gevents_from_epoller(gfds_n)) {
-			std::cerr << DBG_PREFIX"deleting glib events from epoller failed" << std::endl;
-			loop_exit = -1;
-			break;
-		}
-		gevents_added = false;;
+		collect_gevents(gfds_n);
 		if (!g_main_context_acquire(context)) {
-			std::cerr << DBG_PREFIX"acquiring glib context failed" << std::endl;
+			ELOG(ELOG_ERROR, DBG_PREFIX"acquiring glib context failed");
 			loop_exit = -1;
 			break;
 		}
 		if (g_main_context_check(context, g_priority, gfds, gfds_n))
 			g_main_context_dispatch(context);
 		g_main_context_release(context);
+		shrink_gfds(gfds_n);
 
 	} // while (!loop_exit)
 
-	// check to remove gevents
-	if (gevents_added)
-		del_gevents_from_epoller(gfds_n);
+	// remove glib file descriptors, they are registered only while the loop runs
+	clear_gevents();
 
 	return loop_exit > 0;
 }
@@ -288,25 +268,153 @@ void gepoller::set_context(GMainContext *context)
 	this->context = g_main_context_ref(context);
 }
 
-bool gepoller::add_gevents_to_epoller(int gfds_n)
+int gepoller::query_gfds(int g_priority, int *g_timeout)
 {
-	for (int i = 0; i < gfds_n; ++i) {
-		gevents[i].gfd = &gfds[i];
-		if (!gevents[i].add_to_epoller(this))
-			return false;
+	int gfds_n;
+
+	for (;;) {
+		gfds_n = g_main_context_query(context, g_priority, g_timeout, gfds, gevents_size);
+		if (gfds_n <= (int) gevents_size)
+			return gfds_n;
+
+		// grow the array and query again
+		while (gevents_size < (size_t) gfds_n)
+			gevents_size *= 2;
+		delete [] gfds;
+		gfds = new GPollFD[gevents_size];
 	}
+}
 
-	return true;
+void gepoller::shrink_gfds(int gfds_n)
+{
+	size_t size;
+
+	if (gfds_n > gpeak)
+		gpeak = gfds_n;
+
+	if (ggen % GEPOLLER_SHRINK_PERIOD)
+		return;
+
+	// halve the array while the peak fits into its quarter (hysteresis against growing back immediately)
+	size = gevents_size;
+	while (size / 2 >= gevents_min && (size_t) gpeak * 4 <= size)
+		size /= 2;
+	gpeak = 0;
+
+	if (size != gevents_size) {
+		delete [] gfds;
+		gevents_size = size;
+		gfds         = new GPollFD[gevents_size];
+	}
+
+	// keep at most as many events as glib file descriptors may be stored
+	while (!gfree.empty() && gslots.size() + gfree.size() > gevents_size) {
+		delete gfree.back();
+		gfree.pop_back();
+	}
 }
 
-bool gepoller::del_gevents_from_epoller(int gfds_n)
+bool gepoller::sync_gevents(int gfds_n)
 {
+	std::unordered_map<int, gepoller_event*>::iterator it;
+	gepoller_event *gev;
+	uint64_t now = monotonic_msec();
+	bool ok = true, full = false;
+
+	++ggen;
+
+	// re-register all file descriptors from time to time, some of them may have been closed and reopened
+	if (now - gsync >= GEPOLLER_RESYNC_MSEC) {
+		gsync = now;
+		full  = true;
+	}
+
+	// collect requested events, add new file descriptors
 	for (int i = 0; i < gfds_n; ++i) {
-		if (!gevents[i].del_from_epoller(this))
-			return false;
-		gevents[i].gfd = 0;
+		it = gslots.find(gfds[i].fd);
+		if (it == gslots.end()) {
+			if (gfree.empty()) {
+				gev = new gepoller_event;
+			} else {
+				gev = gfree.back();
+				gfree.pop_back();
+			}
+			gev->fd      = gfds[i].fd;
+			gev->events  = gfds[i].events;
+			gev->revents = 0;
+			gev->gen     = ggen;
+			if (!gev->add_to_epoller(this)) {
+				gev->fd = -1;
+				gfree.push_back(gev);
+				return false;
+			}
+			gslots[gev->fd] = gev;
+			continue;
+		}
+
+		gev = it->second;
+		if (gev->gen != ggen) {
+			gev->gen     = ggen;
+			gev->events  = gfds[i].events;
+			gev->revents = 0;
+		} else {
+			gev->events |= gfds[i].events; // the same file descriptor polled more times
+		}
 	}
 
-	return true;
+	// modify changed file descriptors, delete file descriptors not polled any more
+	for (it = gslots.begin(); it != gslots.end(); ) {
+		gev = it->second;
+		if (gev->gen != ggen) {
+			if (!gev->del_from_epoller(this))
+				ok = false;
+			gev->fd = -1;
+			gfree.push_back(gev);
+			it = gslots.erase(it);
+			continue;
+		}
+		if ((full || (int) gev->event.events != gepoller_event::events_glib2epoll(gev->events)) &&
+		    !gev->mod_in_epoller(this))
+			ok = false;
+		++it;
+	}
+
+	return ok;
+}
+
+int gepoller::resync_timeout()
+{
+	uint64_t elapsed;
+
+	if (gslots.empty())
+		return -1;
+
+	elapsed = monotonic_msec() - gsync;
+	return elapsed >= GEPOLLER_RESYNC_MSEC ? 0 : GEPOLLER_RESYNC_MSEC - elapsed;
+}
+
+void gepoller::collect_gevents(int gfds_n)
+{
+	std::unordered_map<int, gepoller_event*>::iterator it;
+
+	for (int i = 0; i < gfds_n; ++i) {
+		it = gslots.find(gfds[i].fd);
+		gfds[i].revents = it == gslots.end() ? 0 :
+		                  it->second->revents & (gfds[i].events | G_IO_ERR | G_IO_HUP | G_IO_NVAL);
+	}
 }
 
+bool gepoller::clear_gevents()
+{
+	bool ok = true;
+
+	for (std::unordered_map<int, gepoller_event*>::iterator it = gslots.begin(); it != gslots.end(); ++it) {
+		if (fd != -1 && !it->second->del_from_epoller(this))
+			ok = false;
+		it->second->fd = -1;
+		gfree.push_back(it->second);
+	}
+	gslots.clear();
+
+	return ok;
+}
@@ -1,17 +1,17 @@
 #include "epoller/gpioepoller.h"
+#include <epoller/log.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <cstdio>
 #include <cstring>
 #include <sstream>
-#include <iostream>
 
 #define DBG_PREFIX "gpioepoller: "
 #define GPIO_DIR   "/sys/class/gpio"
 
 int gpioepoller::receiver::irq(gpioepoller &sender, int value)
 {
-	std::cerr << DBG_PREFIX"unhandled event: irq" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: irq");
 	return -1;
 }
 
@@ -33,7 +33,7 @@ bool gpioepoller::open(const std::string &pathname, int flags)
 
 	int fd = ::open(pathname.c_str(), flags);
 	if (fd == -1) {
-		perror(DBG_PREFIX"opening file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"opening file failed");
 		return false;
 	}
 
@@ -55,12 +55,12 @@ bool gpioepoller::open(int gpio, int flags)
 bool gpioepoller::set(int value)
 {
 	if (lseek(fd, 0, SEEK_SET) == (off_t) -1) {
-		perror(DBG_PREFIX"seeking failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"seeking failed");
 		return false;
 	}
 
 	if (write(fd, value ? "1" : "0", 1) != 1) {
-		perror(DBG_PREFIX"writing failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"writing failed");
 		return false;
 	}
 
@@ -70,12 +70,12 @@ bool gpioepoller::set(int value)
 bool gpioepoller::get(int *value)
 {
 	if (lseek(fd, 0, SEEK_SET) == (off_t) -1) {
-		perror(DBG_PREFIX"seeking failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"seeking failed");
 		return false;
 	}
 
 	if (read(fd, value, 1) != 1) {
-		perror(DBG_PREFIX"reading failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"reading failed");
 		return false;
 	}
 
@@ -100,7 +100,7 @@ int gpioepoller::irq(int value)
 	else if (_irq)
 		return _irq(*this, value);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: irq" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: irq");
 		return -1;
 	}
 }
@@ -120,7 +120,7 @@ bool gpioepoller::set_direction(const std::string &pathname, gpioepoller::DIRECT
 {
 	int fd = ::open(pathname.c_str(), O_WRONLY);
 	if (fd == -1) {
-		perror(DBG_PREFIX"opening direction file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"opening direction file failed");
 		return false;
 	}
 
@@ -135,13 +135,13 @@ bool gpioepoller::set_direction(const std::string &pathname, gpioepoller::DIRECT
 	else if (direction == DIRECTION_HIGH)
 		buff = (char*) "high";
 	else {
-		std::cerr << DBG_PREFIX"invalid direction" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"invalid direction");
 		::close(fd);
 		return false;
 	}
 
 	if ((size_t) write(fd, buff, strlen(buff)) != strlen(buff)) {
-		perror(DBG_PREFIX"writing direction file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"writing direction file failed");
 		::close(fd);
 		return false;
 	}
@@ -161,7 +161,7 @@ bool gpioepoller::get_direction(const std::string &pathname, gpioepoller::DIRECT
 {
 	int fd = ::open(pathname.c_str(), O_RDONLY);
 	if (fd == -1) {
-		perror(DBG_PREFIX"opening direction file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"opening direction file failed");
 		return false;
 	}
 
@@ -169,7 +169,7 @@ bool gpioepoller::get_direction(const std::string &pathname, gpioepoller::DIRECT
 
 	int ret = read(fd, buff, sizeof(buff));
 	if (ret == -1) {
-		perror(DBG_PREFIX"reading direction file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"reading direction file failed");
 		::close(fd);
 		return false;
 	}
@@ -179,7 +179,7 @@ bool gpioepoller::get_direction(const std::string &pathname, gpioepoller::DIRECT
 	else if (!memcmp(buff, "out", 3))
 		*direction = DIRECTION_OUT;
 	else {
-		std::cerr << DBG_PREFIX"unknown value in direction file" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unknown value in direction file");
 		::close(fd);
 		return false;
 	}
@@ -199,7 +199,7 @@ bool gpioepoller::set_edge(const std::string &pathname, gpioepoller::EDGE edge)
 {
 	int fd = ::open(pathname.c_str(), O_WRONLY);
 	if (fd == -1) {
-		perror(DBG_PREFIX"opening edge file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"opening edge file failed");
 		return false;
 	}
 
@@ -214,13 +214,13 @@ bool gpioepoller::set_edge(const std::string &pathname, gpioepoller::EDGE edge)
 	else if (edge == EDGE_BOTH)
 		buff = (char*) "both";
 	else {
-		std::cerr << DBG_PREFIX"invalid edge" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"invalid edge");
 		::close(fd);
 		return false;
 	}
 
 	if ((size_t) write(fd, buff, strlen(buff)) != strlen(buff)) {
-		perror(DBG_PREFIX"writing edge file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"writing edge file failed");
 		::close(fd);
 		return false;
 	}
@@ -240,7 +240,7 @@ bool gpioepoller::get_edge(const std::string &pathname, gpioepoller::EDGE *edge)
 {
 	int fd = ::open(pathname.c_str(), O_RDONLY);
 	if (fd == -1) {
-		perror(DBG_PREFIX"opening edge file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"opening edge file failed");
 		return false;
 	}
 
@@ -248,7 +248,7 @@ bool gpioepoller::get_edge(const std::string &pathname, gpioepoller::EDGE *edge)
 
 	int ret = read(fd, buff, sizeof(buff));
 	if (ret == -1) {
-		perror(DBG_PREFIX"reading edge file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"reading edge file failed");
 		::close(fd);
 		return false;
 	}
@@ -262,7 +262,7 @@ bool gpioepoller::get_edge(const std::string &pathname, gpioepoller::EDGE *edge)
 	else if (!memcmp(buff, "both", 4))
 		*edge = EDGE_BOTH;
 	else {
-		std::cerr << DBG_PREFIX"unknown value in edge file" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unknown value in edge file");
 		::close(fd);
 		return false;
 	}
@@ -282,12 +282,12 @@ bool gpioepoller::set_value(const std::string &pathname, int value)
 {
 	int fd = ::open(pathname.c_str(), O_WRONLY);
 	if (fd == -1) {
-		perror(DBG_PREFIX"opening value file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"opening value file failed");
 		return false;
 	}
 
 	if (write(fd, value ? "1" : "0", 1) != 1) {
-		perror(DBG_PREFIX"writing value file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"writing value file failed");
 		::close(fd);
 		return false;
 	}
@@ -307,12 +307,12 @@ bool gpioepoller::get_value(const std::string &pathname, int *value)
 {
 	int fd = ::open(pathname.c_str(), O_RDONLY);
 	if (fd == -1) {
-		perror(DBG_PREFIX"opening value file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"opening value file failed");
 		return false;
 	}
 
 	if (read(fd, value, 1) != 1) {
-		perror(DBG_PREFIX"reading value file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"reading value file failed");
 		::close(fd);
 		return false;
 	}
@@ -0,0 +1,125 @@
+#include <epoller/gsource.h>
+#include <epoller/log.h>
+#include <errno.h>
+
+#define DBG_PREFIX "epoller_gsource: "
+
+static GSourceFuncs epoller_gsource_funcs = {
+	epoller_gsource::prepare,
+	epoller_gsource::check,
+	epoller_gsource::dispatch,
+	0, 0, 0
+};
+
+GSource *epoller_gsource::create(struct epoller *epoller)
+{
+	if (epoller->fd == -1) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"epoller is not initialized");
+		return 0;
+	}
+
+	GSource *source = g_source_new(&epoller_gsource_funcs, sizeof (struct epoller_gsource));
+	struct epoller_gsource *self = (struct epoller_gsource *) source;
+
+	self->epoller = epoller;
+	self->ready   = false;
+	self->tag     = g_source_add_unix_fd(source, epoller->fd, G_IO_IN);
+	g_source_set_name(source, "epoller");
+
+	// reset exit state left by previous loop (as epoller::loop does), otherwise the source is removed immediately
+	epoller->loop_exit = 0;
+
+	return source;
+}
+
+guint epoller_gsource::attach(struct epoller *epoller, GMainContext *context)
+{
+	GSource *source = create(epoller);
+	guint id;
+
+	if (!source)
+		return 0;
+
+	id = g_source_attach(source, context);
+	g_source_unref(source);
+	return id;
+}
+
+gboolean epoller_gsource::prepare(GSource *source, gint *timeout)
+{
+	struct epoller_gsource *self = (struct epoller_gsource *) source;
+	struct epoller *ep = self->epoller;
+	int r, to = ep->timeout;
+
+	// call pre-epoll handler
+	if (ep->pre_epoll_handler) {
+		r = ep->pre_epoll_handler(ep);
+		if (r) {
+			if (r < 0)
+				ELOG(ELOG_ERROR, DBG_PREFIX"pre_epoll_handler announces exit with error");
+			ep->loop_exit = r > 0 ? 1 : -1;
+			return TRUE; // destroyed by dispatch
+		}
+	}
+
+	// flush events
+	r = ep->flush(&to);
+	if (r) {
+		if (r < 0)
+			ELOG(ELOG_ERROR, DBG_PREFIX"flushed event announces exit with error");
+		ep->loop_exit = r > 0 ? 1 : -1;
+		return TRUE;
+	}
+
+	// do not block if some reception has been deferred
+	self->ready     = ep->rx_deferred > 0;
+	ep->rx_deferred = 0;
+
+	*timeout = self->ready ? 0 : to;
+	return self->ready;
+}
+
+gboolean epoller_gsource::check(GSource *source)
+{
+	struct epoller_gsource *self = (struct epoller_gsource *) source;
+
+	return self->ready || self->epoller->loop_exit || (g_source_query_unix_fd(source, self->tag) & G_IO_IN);
+}
+
+gboolean epoller_gsource::dispatch(GSource *source, GSourceFunc callback, gpointer user_data)
+{
+	struct epoller_gsource *self = (struct epoller_gsource *) source;
+	struct epoller *ep = self->epoller;
+	int r, ret;
+
+	if (ep->loop_exit)
+		return G_SOURCE_REMOVE;
+
+	// call epoll wait
+	do {
+		ret = epoll_wait(ep->fd, ep->revents, ep->revents_size, 0);
+	} while (ret == -1 && errno == EINTR);
+
+	// call post-epoll handler
+	if (ep->post_epoll_handler) {
+		r = ep->post_epoll_handler(ep);
+		if (r) {
+			if (r < 0)
+				ELOG(ELOG_ERROR, DBG_PREFIX"post_epoll_handler announces exit with error");
+			ep->loop_exit = r > 0 ? 1 : -1;
+			return G_SOURCE_REMOVE;
+		}
+	}
+
+	if (ret == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"epoll waiting failed");
+		ep->loop_exit = -1;
+		return G_SOURCE_REMOVE;
+	}
+
+	// dispatch returned events
+	if (ret > 0 && ep->dispatch(ret))
+		return G_SOURCE_REMOVE;
+
+	return G_SOURCE_CONTINUE;
+}
@@ -1,7 +1,9 @@
 #include <epoller/inotepoller.h>
+#include <epoller/log.h>
 #include <unistd.h>
 #include <climits>
-#include <iostream>
+#include <algorithm>
+#include <iterator>
 #include <cstdio>
 #include <cstring>
 
@@ -9,34 +11,42 @@
 
 int inotepoller::receiver::inothandler(inotepoller &sender, struct inotify_event *event)
 {
-	std::cerr << DBG_PREFIX"unhandled event: inothandler" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: inothandler");
 	return -1;
 }
 
-bool inotepoller::init()
+int inotepoller::receiver::overflow(inotepoller &sender, struct inotify_event *event)
+{
+	return inothandler(sender, event);
+}
+
+bool inotepoller::init(size_t buffsize)
 {
 	int ret;
 
 	// check file descriptor
 	if (fd != -1) {
-		std::cerr << DBG_PREFIX"already initialized" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"already initialized");
 		goto unwind;
 	}
 
 	// create inotify file descriptor
 	fd = inotify_init();
 	if (fd == -1) {
-		perror(DBG_PREFIX"file descriptor creation failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"file descriptor creation failed");
 		goto unwind;
 	}
 
+	// allocate buffer for read events
+	buff.resize(std::max(buffsize, sizeof(struct inotify_event) + NAME_MAX + 1));
+
 	// add inotify file descriptor to epoller
 	memset(&event, 0, sizeof event);
 	event.data.ptr = this;
 	event.events = EPOLLIN;
 	ret = epoll_ctl(epoller->fd, EPOLL_CTL_ADD, fd, &event);
 	if (ret == -1) {
-		perror(DBG_PREFIX"adding file descriptor to epoller failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"adding file descriptor to epoller failed");
 		goto unwind_fd;
 	}
 
@@ -52,13 +62,27 @@ unwind:
 
 void inotepoller::cleanup()
 {
+	// drop coalesced events
+	coalesce_msec  = 0;
+	coalesce_armed = false;
+	pending.clear();
+	pending_keys.clear();
+	coalesce_timer.cleanup();
+
 	// check file descriptor
 	if (fd == -1)
 		return; // already cleaned-up
 
+	// drop events not dispatched yet
+	if (queued) {
+		epoller->del_flush(this);
+		queued = false;
+	}
+	buff_pos = buff_len = 0;
+
 	// remove inotify file descriptor from epoller
 	if (epoller->fd != -1 && epoll_ctl(epoller->fd, EPOLL_CTL_DEL, fd, NULL) == -1)
-		perror(DBG_PREFIX"removing file descriptor from epoller failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"removing file descriptor from epoller failed");
 
 	// close and invalidate inotify file descriptor
 	close(fd);
@@ -69,7 +93,7 @@ int inotepoller::add_watch(const std::string &pathname, uint32_t mask)
 {
 	int wd = inotify_add_watch(fd, pathname.c_str(), mask);
 	if (wd == -1)
-		perror(DBG_PREFIX"adding watch failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"adding watch failed");
 
 	return wd;
 }
@@ -78,7 +102,7 @@ bool inotepoller::rm_watch(int wd)
 {
 	int ret = inotify_rm_watch(fd, wd);
 	if (ret == -1) {
-		perror(DBG_PREFIX"removing watch failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"removing watch failed");
 		return false;
 	}
 
@@ -88,51 +112,257 @@ bool inotepoller::rm_watch(int wd)
 int inotepoller::handler(struct epoller *epoller, struct epoll_event *revent)
 {
 	int ret;
-	uint8_t buff[sizeof(struct inotify_event) + NAME_MAX + 1];
-	struct inotify_event *event = (struct inotify_event *)buff;
+	ssize_t len;
+	struct epoller_event **pthis = epoller_event::pthis;
 
 	if (revent->events & EPOLLIN) {
 		revent->events &= ~EPOLLIN;
 
-		ret = read(fd, event, sizeof buff);
-		if (ret == -1) {
-			perror(DBG_PREFIX"reading from file descriptor failed");
+		// events left from the previous read go first
+		ret = dispatch();
+		if (ret || !*pthis || fd == -1)
+			return ret;
+
+		len = read(fd, buff.data(), buff.size());
+		if (len == -1) {
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"reading from file descriptor failed");
 			return -1;
 
-		} else if (ret == 0) {
-			perror(DBG_PREFIX"no data read from file descriptor");
+		} else if (len == 0) {
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"no data read from file descriptor");
 			return -1;
+		}
 
-		} else {
-			if (ret < (int)sizeof(struct inotify_event)) {
-				perror(DBG_PREFIX"mismatched data read from file descriptor");
-				return -1;
-			}
+		buff_pos = 0;
+		buff_len = len;
 
-			return inothandler(event);
-		}
+		return dispatch();
 	}
 
 	if (revent->events & EPOLLHUP) {
 		revent->events &= ~EPOLLHUP;
-		std::cerr << DBG_PREFIX"unexpected EPOLLHUP on file descriptor" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected EPOLLHUP on file descriptor");
 		return -1;
 	}
 
 	if (revent->events & EPOLLERR) {
 		revent->events &= ~EPOLLERR;
-		std::cerr << DBG_PREFIX"unexpected EPOLLERR on file descriptor" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected EPOLLERR on file descriptor");
 		return -1;
 	}
 
 	if (revent->events) {
-		std::cerr << DBG_PREFIX"unexpected unknown event on file descriptor, events = " << revent->events << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected unknown event on file descriptor, events = %u", revent->events);
+		return -1;
+	}
+
+	return 0;
+}
+
+int inotepoller::dispatch()
+{
+	int ret;
+	size_t pos;
+	struct inotify_event *event;
+	struct epoller_event **pthis = epoller_event::pthis;
+
+	while (buff_pos < buff_len) {
+		event = (struct inotify_event *)(buff.data() + buff_pos);
+		if (buff_len - buff_pos < sizeof(struct inotify_event) ||
+		    buff_len - buff_pos < sizeof(struct inotify_event) + event->len) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"mismatched data read from file descriptor");
+			buff_pos = buff_len = 0;
+			return -1;
+		}
+		pos       = buff_pos;
+		buff_pos += sizeof(struct inotify_event) + event->len;
+
+		if (event->mask & IN_Q_OVERFLOW) {
+			// pending coalesced events go first, the overflow is dispatched again if they stop dispatching
+			ret = pending.empty() ? 0 : flush_coalesced(pthis, true);
+			if (ret) {
+				if (*pthis && fd != -1)
+					buff_pos = pos;
+			} else if (*pthis && fd != -1) {
+				overflow_cnt++;
+				ELOG(ELOG_WARNING, DBG_PREFIX"event queue overflowed, some events have been lost");
+				ret = overflow(event);
+			}
+		} else
+			ret = coalesce_msec ? coalesce_event(event) : inothandler(event);
+
+		if (ret || !*pthis || fd == -1) {
+			// the rest is dispatched just before next epoll_wait (unless the inotify epoller is gone)
+			if (*pthis && fd != -1 && buff_pos < buff_len && !queued) {
+				queued = true;
+				epoller->add_flush(this);
+			}
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+int inotepoller::flush(struct epoller *epoller, int *timeout)
+{
+	queued = false;
+	if (fd == -1)
+		return 0;
+
+	return dispatch();
+}
+
+/// @brief Arms coalescing timer for the end of quiet window of the oldest pending event.
+static bool arm_coalesce_timer(inotepoller &ino)
+{
+	struct timespec ts = ino.pending.front().last;
+
+	ts.tv_sec  += ino.coalesce_msec / 1000;
+	ts.tv_nsec += (ino.coalesce_msec % 1000) * 1000000L;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	ino.coalesce_armed = ino.coalesce_timer.arm_oneshot(&ts, TFD_TIMER_ABSTIME);
+	return ino.coalesce_armed;
+}
+
+bool inotepoller::coalesce(unsigned int msec)
+{
+	if (msec && coalesce_timer.fd == -1) {
+		// the parent epoller may have been set after construction
+		coalesce_timer.epoller = epoller;
+		coalesce_timer.rcvr    = this;
+		if (!coalesce_timer.init()) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"coalescing timer initialization failed");
+			return false;
+		}
+	}
+
+	coalesce_msec = msec;
+
+	// let the pending events be delivered by the timer (immediately if coalescing is disabled)
+	if (!pending.empty())
+		return arm_coalesce_timer(*this);
+
+	return true;
+}
+
+int inotepoller::coalesce_event(struct inotify_event *event)
+{
+	std::map<coalesced_key, coalesced_list::iterator>::iterator it;
+	struct epoller_event **pthis = epoller_event::pthis;
+	struct timespec now;
+	int ret;
+
+	// events paired by cookie and events ending the watch are not coalesced, but delivered in order
+	if (event->cookie || (event->mask & (IN_IGNORED | IN_UNMOUNT))) {
+		if (!pending.empty()) {
+			if (event->cookie)
+				ret = flush_coalesced(pthis, false, event->wd, event->len ? event->name : "");
+			else
+				ret = flush_coalesced(pthis, false, event->wd);
+			if (ret || !*pthis || fd == -1)
+				return ret;
+		}
+
+		return inothandler(event);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	it = pending_keys.find(coalesced_key(event->wd, event->len ? event->name : ""));
+	if (it != pending_keys.end()) {
+		// merge into pending event and move it to the end of the list
+		it->second->mask |= event->mask;
+		it->second->last  = now;
+		pending.splice(pending.end(), pending, it->second);
+		coalesced_cnt++;
+	} else {
+		pending.push_back(coalesced{event->wd, event->mask, event->len ? event->name : "", now});
+		pending_keys[coalesced_key(event->wd, pending.back().name)] = --pending.end();
+	}
+
+	if (!coalesce_armed && !arm_coalesce_timer(*this))
 		return -1;
+
+	return 0;
+}
+
+int inotepoller::flush_coalesced(struct epoller_event **pthis, bool all, int wd, const char *name)
+{
+	union {
+		struct inotify_event event;
+		uint8_t              raw[sizeof(struct inotify_event) + NAME_MAX + 1];
+	} u;
+	std::map<coalesced_key, coalesced_list::iterator>::iterator it;
+	coalesced_list::iterator li, next;
+	struct timespec now;
+	long long age;
+	int ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	for (li = pending.begin(); li != pending.end(); li = next) {
+		next = std::next(li);
+
+		if (name) {
+			// single event looked up directly
+			it = pending_keys.find(coalesced_key(wd, name));
+			if (it == pending_keys.end())
+				return 0;
+			li   = it->second;
+			next = pending.end();
+
+		} else if (wd >= 0) {
+			if (li->wd != wd)
+				continue;
+
+		} else if (!all) {
+			// events are ordered by time, so the rest is not quiet long enough as well
+			age = (now.tv_sec - li->last.tv_sec) * 1000LL + (now.tv_nsec - li->last.tv_nsec) / 1000000LL;
+			if (age < coalesce_msec)
+				break;
+		}
+
+		memset(&u.event, 0, sizeof u.event);
+		u.event.wd   = li->wd;
+		u.event.mask = li->mask;
+		if (!li->name.empty()) {
+			u.event.len = li->name.size() + 1;
+			memcpy(u.event.name, li->name.c_str(), u.event.len);
+		}
+
+		pending_keys.erase(coalesced_key(li->wd, li->name));
+		pending.erase(li);
+
+		ret = inothandler(&u.event);
+		if (ret || (pthis && !*pthis) || fd == -1)
+			return ret;
 	}
 
 	return 0;
 }
 
+int inotepoller::timerhandler(timepoller &sender, uint64_t exp)
+{
+	struct epoller_event **pthis = sender.pthis;
+	int ret;
+
+	coalesce_armed = false;
+
+	ret = flush_coalesced(pthis, !coalesce_msec);
+	if (ret || (pthis && !*pthis) || fd == -1)
+		return ret;
+
+	if (!pending.empty() && !arm_coalesce_timer(*this))
+		return -1;
+
+	return 0;
+}
+
 int inotepoller::inothandler(struct inotify_event *event)
 {
 	if (rcvr)
@@ -140,8 +370,18 @@ int inotepoller::inothandler(struct inotify_event *event)
 	else if (_inothandler)
 		return _inothandler(*this, event);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: inothandler" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: inothandler");
 		return -1;
 	}
 }
 
+
+int inotepoller::overflow(struct inotify_event *event)
+{
+	if (rcvr)
+		return rcvr->overflow(*this, event);
+	else if (_overflow)
+		return _overflow(*this, event);
+	else
+		return inothandler(event);
+}
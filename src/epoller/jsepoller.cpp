@@ -1,12 +1,12 @@
 #include <epoller/jsepoller.h>
+#include <epoller/log.h>
 #include <fcntl.h>
-#include <iostream>
 
 #define DBG_PREFIX "jsepoller: "
 
 int jsepoller::receiver::jshandler(jsepoller &sender, struct js_event *event)
 {
-	std::cerr << DBG_PREFIX"unhandled event: jshandler" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: jshandler");
 	return -1;
 }
 
@@ -19,10 +19,13 @@ bool jsepoller::open(const std::string &pathname, size_t evbuff)
 	                     true,                             /* rxen   */
 	                     false,                            /* txen   */
 	                     true)) {                          /* en     */
-		std::cerr << DBG_PREFIX"opening " << pathname << " failed" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"opening %s failed", pathname.c_str());
 		return false;
 	}
 
+	jsframer.init_fixed(sizeof(struct js_event));
+	frmr = &jsframer;
+
 	return true;
 }
 
@@ -65,29 +68,15 @@ int jsepoller::set_corr(const struct js_corr *corr)
 
 int jsepoller::rx(int len)
 {
-	int ret;
-
-	if (len < 0) {
-		return -1;
-
-	} else if (len == 0) {
+	if (len <= 0)
 		return -1;
 
-	} else {
-
-		while (linbuff_tord(&rxbuff) >= sizeof(struct js_event)) {
-
-			struct js_event *event = (struct js_event*)LINBUFF_RD_PTR(&rxbuff);
-
-			if ((ret = jshandler(event)))
-				return ret;
-
-			linbuff_skip(&rxbuff, sizeof(struct js_event));
-		}
+	return fdepoller::rx(len);
+}
 
-		linbuff_compact(&rxbuff);
-		return 0;
-	}
+int jsepoller::frame(const uint8_t *data, size_t len)
+{
+	return jshandler((struct js_event*)data);
 }
 
 int jsepoller::jshandler(struct js_event *event)
@@ -97,7 +86,7 @@ int jsepoller::jshandler(struct js_event *event)
 	else if (_jshandler)
 		return _jshandler(*this, event);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: jshandler" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: jshandler");
 		return -1;
 	}
 }
@@ -0,0 +1,214 @@
+#include <epoller/log.h>
+#include <string.h>
+#include <time.h>
+#include <cstdarg>
+#include <cstdio>
+#include <new>
+#include <thread>
+
+/// @brief Period of polling of empty ring by drain thread in nanoseconds.
+#define ELOG_DRAIN_PERIOD 1000000
+
+/// @brief Message slot of asynchronous ring.
+struct elog_cell
+{
+	std::atomic<size_t> seq;                ///< sequence number (bounded MPMC queue by D. Vyukov)
+	enum elog_level     level;              ///< message severity
+	size_t              len;                ///< message length
+	char                msg[ELOG_MSG_SIZE]; ///< message
+};
+
+std::atomic<int> elog_threshold(ELOG_INFO);
+
+static struct elog_stderr_sink        stderr_sink;
+static std::atomic<struct elog_sink*> sink(&stderr_sink);
+static std::atomic<unsigned int>      rate_burst(0);
+static std::atomic<unsigned int>      rate_interval(1000);
+
+static struct elog_cell         *ring = 0;      // asynchronous ring
+static size_t                    ring_mask = 0; // ring size - 1
+static std::atomic<size_t>       ring_wr(0);    // position of next enqueued message
+static size_t                    ring_rd = 0;   // position of next dequeued message (drain thread only)
+static std::atomic<bool>         async(false);  // asynchronous mode is active
+static std::atomic<bool>         stopping(false);
+static std::atomic<unsigned long> dropped(0);
+static std::thread               drainer;
+
+void elog_stderr_sink::write(enum elog_level level, const char *msg, size_t len)
+{
+	fprintf(stderr, "%s\n", msg);
+}
+
+void elog_set_level(enum elog_level level)
+{
+	elog_threshold.store(level, std::memory_order_relaxed);
+}
+
+void elog_set_sink(struct elog_sink *s)
+{
+	sink.store(s ? s : &stderr_sink);
+}
+
+void elog_set_rate_limit(unsigned int burst, unsigned int interval_ms)
+{
+	rate_interval.store(interval_ms ? interval_ms : 1, std::memory_order_relaxed);
+	rate_burst.store(burst, std::memory_order_relaxed);
+}
+
+static bool enqueue(enum elog_level level, const char *msg, size_t len)
+{
+	struct elog_cell *cell;
+	size_t pos = ring_wr.load(std::memory_order_relaxed), seq;
+
+	for (;;) {
+		cell = &ring[pos & ring_mask];
+		seq  = cell->seq.load(std::memory_order_acquire);
+		if (seq == pos) {
+			if (ring_wr.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (seq < pos) {
+			return false; // full
+		} else {
+			pos = ring_wr.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->level = level;
+	cell->len   = len;
+	memcpy(cell->msg, msg, len + 1);
+	cell->seq.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+static bool drain()
+{
+	struct elog_cell *cell;
+	bool any = false;
+
+	for (;;) {
+		cell = &ring[ring_rd & ring_mask];
+		if (cell->seq.load(std::memory_order_acquire) != ring_rd + 1)
+			return any;
+		sink.load()->write(cell->level, cell->msg, cell->len);
+		cell->seq.store(ring_rd + ring_mask + 1, std::memory_order_release);
+		ring_rd++;
+		any = true;
+	}
+}
+
+static void drain_thread()
+{
+	struct timespec ts = {0, ELOG_DRAIN_PERIOD};
+
+	for (;;) {
+		if (drain())
+			continue;
+		if (stopping.load())
+			break;
+		nanosleep(&ts, 0);
+	}
+	drain();
+}
+
+bool elog_async_start(size_t size)
+{
+	size_t n = 2;
+
+	if (async.load())
+		return true;
+
+	while (n < size)
+		n <<= 1;
+
+	ring = new (std::nothrow) elog_cell[n];
+	if (!ring) {
+		fprintf(stderr, "elog: ring allocation failed\n");
+		return false;
+	}
+	for (size_t i = 0; i < n; ++i)
+		ring[i].seq.store(i, std::memory_order_relaxed);
+	ring_mask = n - 1;
+	ring_wr.store(0);
+	ring_rd = 0;
+	stopping.store(false);
+
+	try {
+		drainer = std::thread(drain_thread);
+	} catch (...) {
+		fprintf(stderr, "elog: starting drain thread failed\n");
+		delete[] ring;
+		ring = 0;
+		return false;
+	}
+
+	async.store(true);
+	return true;
+}
+
+void elog_async_stop()
+{
+	if (!async.load())
+		return;
+
+	async.store(false);
+	stopping.store(true);
+	drainer.join();
+
+	delete[] ring;
+	ring = 0;
+}
+
+unsigned long elog_dropped()
+{
+	return dropped.load(std::memory_order_relaxed);
+}
+
+void elog(enum elog_level level, struct elog_site *site, int errnum, const char *fmt, ...)
+{
+	char msg[ELOG_MSG_SIZE], err[128];
+	unsigned int burst = rate_burst.load(std::memory_order_relaxed), suppressed = 0;
+	struct timespec ts;
+	uint64_t now, window;
+	va_list args;
+	int len;
+
+	// rate limiting
+	if (site && burst) {
+		clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+		now    = (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+		window = site->window.load(std::memory_order_relaxed);
+		if (now - window >= rate_interval.load(std::memory_order_relaxed) &&
+		    site->window.compare_exchange_strong(window, now, std::memory_order_relaxed))
+			site->count.store(0, std::memory_order_relaxed);
+		if (site->count.fetch_add(1, std::memory_order_relaxed) >= burst) {
+			site->suppressed.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		suppressed = site->suppressed.exchange(0, std::memory_order_relaxed);
+	}
+
+	// format message
+	va_start(args, fmt);
+	len = vsnprintf(msg, sizeof msg, fmt, args);
+	va_end(args);
+	if (len < 0)
+		return;
+	if (len >= (int) sizeof msg)
+		len = sizeof msg - 1;
+
+	if (errnum >= 0 && len < (int) sizeof msg - 1)
+		len += snprintf(msg + len, sizeof msg - len, ": %s", strerror_r(errnum, err, sizeof err));
+	if (suppressed && len < (int) sizeof msg - 1)
+		len += snprintf(msg + len, sizeof msg - len, " (%u similar messages suppressed)", suppressed);
+	if (len >= (int) sizeof msg)
+		len = sizeof msg - 1;
+
+	// write message
+	if (async.load(std::memory_order_acquire)) {
+		if (!enqueue(level, msg, len))
+			dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	sink.load()->write(level, msg, len);
+}
@@ -0,0 +1,163 @@
+#include <epoller/migrator.h>
+#include <epoller/balancer.h>
+#include <epoller/log.h>
+#include <algorithm>
+
+#define DBG_PREFIX "migrator: "
+
+int migrator::receiver::migrated(migrator &sender, struct epoller_event *ev, bool attached)
+{
+	return 0;
+}
+
+bool migrator::init()
+{
+	wakeup.rcvr = this;
+	ticker.rcvr = this;
+
+	if (!wakeup.init(0, EFD_NONBLOCK)) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"wakeup event initialization failed");
+		return false;
+	}
+
+	return true;
+}
+
+void migrator::cleanup()
+{
+	struct node *n = incoming.exchange(0, std::memory_order_acquire), *next;
+
+	for (; n; n = next) {
+		next = n->next;
+		delete n;
+	}
+
+	ticker.cleanup();
+	wakeup.cleanup();
+	members.clear();
+}
+
+bool migrator::migrate(struct epoller_event *ev, migrator &target)
+{
+	struct node *n = new struct node;
+
+	n->ev     = ev;
+	n->member = forget(ev);
+
+	if (!ev->detach()) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"detaching event failed");
+		if (n->member)
+			adopt(ev);
+		delete n;
+		return false;
+	}
+
+	// push to the target stack, the first pusher wakes the target epoller up
+	n->next = target.incoming.load(std::memory_order_relaxed);
+	while (!target.incoming.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed))
+		;
+	if (!n->next && !target.wakeup.send())
+		ELOG(ELOG_ERROR, DBG_PREFIX"waking target epoller up failed");
+
+	sent_cnt++;
+	return true;
+}
+
+bool migrator::forget(struct epoller_event *ev)
+{
+	std::vector<struct epoller_event*>::reverse_iterator it = std::find(members.rbegin(), members.rend(), ev);
+
+	if (it == members.rend())
+		return false;
+
+	*it = members.back();
+	members.pop_back();
+	return true;
+}
+
+bool migrator::balance(struct balancer *blncr, uint64_t msec)
+{
+	if (!ticker.init()) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"ticker initialization failed");
+		return false;
+	}
+
+	// the first sample is taken by the first tick (in the thread running the parent epoller)
+	last_time.tv_sec  = 0;
+	last_time.tv_nsec = 0;
+
+	if (!ticker.arm_periodic_msec(msec)) {
+		ticker.cleanup();
+		return false;
+	}
+
+	this->blncr = blncr;
+	blncr->loops.push_back(this);
+	return true;
+}
+
+int migrator::recv_handler(evepoller &sender, uint64_t cnt)
+{
+	struct node *n = incoming.exchange(0, std::memory_order_acquire), *prev = 0, *next;
+	int ret = 0;
+
+	// reverse the stack, so the events are attached in order of migration
+	for (; n; n = next) {
+		next    = n->next;
+		n->next = prev;
+		prev    = n;
+	}
+
+	for (n = prev; n; n = next) {
+		next = n->next;
+
+		bool attached = n->ev->attach(epoller);
+		if (!attached)
+			ELOG(ELOG_ERROR, DBG_PREFIX"attaching event failed");
+		else if (n->member)
+			adopt(n->ev);
+		recv_cnt++;
+
+		if (!ret)
+			ret = migrated(n->ev, attached);
+		delete n;
+	}
+
+	return ret;
+}
+
+int migrator::timerhandler(timepoller &sender, uint64_t exp)
+{
+	struct timespec now, cpu;
+	double elapsed;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+
+	if (!last_time.tv_sec && !last_time.tv_nsec) {
+		last_time = now;
+		last_cpu  = cpu;
+		last_cnt  = epoller->handled_cnt;
+		return 0;
+	}
+
+	elapsed = (now.tv_sec - last_time.tv_sec) + (now.tv_nsec - last_time.tv_nsec) / 1e9;
+	if (elapsed <= 0)
+		return 0;
+
+	if (!blncr || blncr->metric == balancer::CPU)
+		load.store(((cpu.tv_sec - last_cpu.tv_sec) + (cpu.tv_nsec - last_cpu.tv_nsec) / 1e9) / elapsed);
+	else
+		load.store((epoller->handled_cnt - last_cnt) / elapsed);
+
+	last_time = now;
+	last_cpu  = cpu;
+	last_cnt  = epoller->handled_cnt;
+
+	return blncr ? blncr->rebalance(*this) : 0;
+}
+
+int migrator::migrated(struct epoller_event *ev, bool attached)
+{
+	return rcvr ? rcvr->migrated(*this, ev, attached) : (_migrated ? _migrated(*this, ev, attached) : 0);
+}
@@ -1,30 +1,62 @@
 #include <epoller/mntepoller.h>
+#include <epoller/log.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 
 #define DBG_PREFIX "mntepoller: "
 
-static inline mntentry parse_entry(const std::string sline)
+/// @brief Computes hash of dir (FNV-1a).
+static inline uint32_t hash_dir(const char *dir, size_t len)
 {
-	mntentry entry;
-	std::stringstream ssline(sline);
+	uint32_t h = 2166136261u;
 
-	ssline >> entry.fsname;
-	ssline >> entry.dir;
-	ssline >> entry.type;
-	ssline >> entry.opts;
-	ssline >> entry.freq;
-	ssline >> entry.passno;
+	while (len--)
+		h = (h ^ (uint8_t) *dir++) * 16777619u;
 
-	return entry;
+	return h;
+}
+
+/// @brief Skips blanks and cuts next blank separated field.
+static inline mntepoller::field cut_field(const char *base, const char *&p, const char *end)
+{
+	mntepoller::field f;
+
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	f.off = p - base;
+	while (p < end && *p != ' ' && *p != '\t')
+		p++;
+	f.len = p - base - f.off;
+
+	return f;
+}
+
+/// @brief Parses next blank separated number.
+static inline int cut_number(const char *&p, const char *end)
+{
+	int n = 0;
+
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	while (p < end && *p >= '0' && *p <= '9')
+		n = n * 10 + (*p++ - '0');
+
+	return n;
 }
 
 int mntepoller::receiver::change(mntepoller &sender, const std::list<mntentry> &entries)
 {
-	std::cerr << DBG_PREFIX"unhandled event: change" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: change");
+	return -1;
+}
+
+int mntepoller::receiver::changes(mntepoller &sender, const mntdiff &diff)
+{
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: changes");
 	return -1;
 }
 
@@ -37,7 +69,7 @@ bool mntepoller::open(const std::string &pathname)
 	                     true,                  /* rxen   */
 	                     false,                 /* txen   */
 	                     true)) {               /* en     */
-		std::cerr << DBG_PREFIX"opening " << pathname << " failed" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"opening %s failed", pathname.c_str());
 		return false;
 	}
 
@@ -53,7 +85,7 @@ int mntepoller::rx(int len)
 		return done();
 	} else {
 		if (!linbuff_towr(&rxbuff) && !linbuff_realloc(&rxbuff, 2 * rxbuff.size)) {
-			std::cerr << DBG_PREFIX"buffer reallocation failed" << std::endl;
+			ELOG(ELOG_ERROR, DBG_PREFIX"buffer reallocation failed");
 			return -1;
 		}
 		return 0;
@@ -69,20 +101,76 @@ int mntepoller::err()
 
 int mntepoller::done()
 {
-	int ret;
-	std::string sline;
+	struct snapshot &prev = snaps[snap], &next = snaps[snap ^ 1];
 	std::list<mntentry> entries;
-	std::stringstream sslines(std::string((char *)LINBUFF_RD_PTR(&rxbuff), linbuff_tord(&rxbuff)));
+	int j;
 
-	while (std::getline(sslines, sline))
-		entries.push_back(parse_entry(sline));
+	// take over content of the mount file (capacity of the snapshot is reused)
+	next.data.assign((const char *) LINBUFF_RD_PTR(&rxbuff), linbuff_tord(&rxbuff));
+	linbuff_clear(&rxbuff);
+	parse(next);
 
-	if ((ret = change(entries)))
-		return ret;
+	if (!incremental) {
+		for (size_t i = 0; i < next.lines.size(); ++i) {
+			entries.push_back(mntentry());
+			to_entry(next, next.lines[i], entries.back());
+		}
 
-	linbuff_clear(&rxbuff);
+		return change(entries);
+	}
 
-	return 0;
+	diff.clear();
+	for (size_t i = 0; i < prev.lines.size(); ++i)
+		prev.lines[i].matched = false;
+
+	// pair identical lines first (unchanged entries)
+	for (size_t i = 0; i < next.lines.size(); ++i) {
+		struct line &l = next.lines[i];
+
+		for (j = lookup(prev, next.data.data() + l.dir.off, l.dir.len); j != -1; j = prev.lines[j].next) {
+			struct line &o = prev.lines[j];
+
+			if (!o.matched && o.all.len == l.all.len &&
+			    !memcmp(prev.data.data() + o.all.off, next.data.data() + l.all.off, l.all.len)) {
+				o.matched = l.matched = true;
+				break;
+			}
+		}
+	}
+
+	// then pair remaining lines by dir (changed entries), unpaired ones are added
+	for (size_t i = 0; i < next.lines.size(); ++i) {
+		struct line &l = next.lines[i];
+
+		if (l.matched)
+			continue;
+
+		for (j = lookup(prev, next.data.data() + l.dir.off, l.dir.len); j != -1; j = prev.lines[j].next)
+			if (!prev.lines[j].matched)
+				break;
+
+		if (j != -1) {
+			prev.lines[j].matched = l.matched = true;
+			diff.changed.push_back(std::pair<mntentry, mntentry>());
+			to_entry(prev, prev.lines[j], diff.changed.back().first);
+			to_entry(next, l, diff.changed.back().second);
+		} else {
+			diff.added.push_back(mntentry());
+			to_entry(next, l, diff.added.back());
+		}
+	}
+
+	// unpaired previous lines are removed
+	for (size_t i = 0; i < prev.lines.size(); ++i) {
+		if (prev.lines[i].matched)
+			continue;
+		diff.removed.push_back(mntentry());
+		to_entry(prev, prev.lines[i], diff.removed.back());
+	}
+
+	snap ^= 1;
+
+	return diff.empty() ? 0 : changes(diff);
 }
 
 int mntepoller::change(const std::list<mntentry> &entries)
@@ -92,24 +180,120 @@ int mntepoller::change(const std::list<mntentry> &entries)
 	else if (_change)
 		return _change(*this, entries);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: change" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: change");
 		return -1;
 	}
 }
 
+int mntepoller::changes(const mntdiff &diff)
+{
+	if (rcvr)
+		return dynamic_cast<receiver *>(rcvr)->changes(*this, diff);
+	else if (_changes)
+		return _changes(*this, diff);
+	else {
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: changes");
+		return -1;
+	}
+}
+
+void mntepoller::parse(struct snapshot &snap)
+{
+	const char *base = snap.data.data(), *p = base, *end = base + snap.data.size(), *eol;
+	struct line l;
+	size_t size = 16, h;
+
+	snap.lines.clear();
+
+	for (; p < end; p = eol + 1) {
+		eol = (const char *) memchr(p, '\n', end - p);
+		if (!eol)
+			eol = end;
+
+		l.all.off = p - base;
+		l.all.len = eol - p;
+		l.fsname  = cut_field(base, p, eol);
+		l.dir     = cut_field(base, p, eol);
+		l.type    = cut_field(base, p, eol);
+		l.opts    = cut_field(base, p, eol);
+		l.freq    = cut_number(p, eol);
+		l.passno  = cut_number(p, eol);
+		l.next    = -1;
+		l.matched = false;
+
+		if (l.dir.len)
+			snap.lines.push_back(l); // skip empty lines
+	}
+
+	// index lines by dir, lines with the same dir are chained
+	while (size < 2 * snap.lines.size())
+		size <<= 1;
+	snap.index.assign(size, -1);
+
+	for (size_t i = 0; i < snap.lines.size(); ++i) {
+		struct line &n = snap.lines[i];
+
+		for (h = hash_dir(base + n.dir.off, n.dir.len) & (size - 1); snap.index[h] != -1; h = (h + 1) & (size - 1)) {
+			struct line &o = snap.lines[snap.index[h]];
+			if (o.dir.len == n.dir.len && !memcmp(base + o.dir.off, base + n.dir.off, n.dir.len))
+				break;
+		}
+
+		n.next        = snap.index[h];
+		snap.index[h] = i;
+	}
+}
+
+int mntepoller::lookup(const struct snapshot &snap, const char *dir, size_t len)
+{
+	const char *base = snap.data.data();
+	size_t size = snap.index.size(), h;
+
+	if (!size)
+		return -1;
+
+	for (h = hash_dir(dir, len) & (size - 1); snap.index[h] != -1; h = (h + 1) & (size - 1)) {
+		const struct line &o = snap.lines[snap.index[h]];
+		if (o.dir.len == len && !memcmp(base + o.dir.off, dir, len))
+			return snap.index[h];
+	}
+
+	return -1;
+}
+
+void mntepoller::to_entry(const struct snapshot &snap, const struct line &l, mntentry &entry)
+{
+	const char *base = snap.data.data();
+
+	entry.fsname.assign(base + l.fsname.off, l.fsname.len);
+	entry.dir   .assign(base + l.dir.off,    l.dir.len   );
+	entry.type  .assign(base + l.type.off,   l.type.len  );
+	entry.opts  .assign(base + l.opts.off,   l.opts.len  );
+	entry.freq   = l.freq;
+	entry.passno = l.passno;
+}
+
 bool mntepoller::read(std::list<mntentry> &entries, const std::string &pathname)
 {
+	struct snapshot snap;
+	std::stringstream ss;
+
 	entries.clear();
 
 	std::ifstream ifs(pathname.c_str());
 	if (!ifs.is_open()) {
-		std::cerr << DBG_PREFIX"opening " << pathname << " failed" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"opening %s failed", pathname.c_str());
 		return false;
 	}
 
-	std::string sline;
-	while (std::getline(ifs, sline))
-		entries.push_back(parse_entry(sline));
+	ss << ifs.rdbuf();
+	snap.data = ss.str();
+	parse(snap);
+
+	for (size_t i = 0; i < snap.lines.size(); ++i) {
+		entries.push_back(mntentry());
+		to_entry(snap, snap.lines[i], entries.back());
+	}
 
 	return true;
 }
@@ -0,0 +1,382 @@
+#include <epoller/procepoller.h>
+#include <epoller/log.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+
+#define DBG_PREFIX "procepoller: "
+
+#ifndef P_PIDFD
+#define P_PIDFD ((idtype_t) 3)
+#endif
+
+#ifndef CLONE_PIDFD
+#define CLONE_PIDFD 0x00001000
+#endif
+
+/// @brief Size of stack the child runs on until exec.
+#define SPAWN_STACK_SIZE 65536
+
+extern char **environ;
+
+/// @brief Arguments of the child spawned by clone_spawn.
+struct spawn_args
+{
+	const char  *path;   ///< path of the executable
+	char *const *argv;   ///< arguments
+	char *const *envp;   ///< environment
+	const int   *stdio;  ///< file descriptors to be duplicated to standard streams (-1 for inherited ones)
+	int          err;    ///< error number of failed exec (set by the child)
+};
+
+/// @brief Runs in the child (sharing memory with the suspended parent) until exec.
+static int spawn_child(void *arg)
+{
+	struct spawn_args *args = (struct spawn_args *) arg;
+	struct sigaction sa;
+	sigset_t sigs;
+	int i;
+
+	// handlers of the parent must not run in the child, so dispositions are reset before signals are unblocked
+	memset(&sa, 0, sizeof sa);
+	sa.sa_handler = SIG_DFL;
+	for (i = 1; i < NSIG; ++i)
+		sigaction(i, &sa, NULL);
+
+	sigemptyset(&sigs);
+	sigprocmask(SIG_SETMASK, &sigs, NULL);
+
+	for (i = 0; i < 3; ++i) {
+		if (args->stdio[i] == -1)
+			continue;
+		if (args->stdio[i] == i ? fcntl(i, F_SETFD, 0) == -1 : dup2(args->stdio[i], i) == -1)
+			goto fail;
+	}
+
+	execve(args->path, args->argv, args->envp);
+
+fail:
+	args->err = errno;
+	_exit(127);
+}
+
+/// @brief Spawns the child by clone with CLONE_PIDFD, so its process file descriptor is got atomically.
+/// @return zero if spawning was successful, -1 if CLONE_PIDFD is not supported, otherwise error number
+static int clone_spawn(pid_t *pid, int *pidfd, const char *path, const int stdio[3], char *const argv[],
+                       char *const envp[])
+{
+	struct spawn_args args = {path, argv, envp, stdio, 0};
+	sigset_t all, old;
+	void *stack;
+	int err;
+
+	stack = mmap(NULL, SPAWN_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+	if (stack == MAP_FAILED)
+		return errno;
+
+	// no handler of the parent may run in the child before its dispositions are reset
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+
+	// the parent is suspended until the child execs or exits (like vfork)
+	*pid = clone(spawn_child, (uint8_t *) stack + SPAWN_STACK_SIZE, CLONE_VM | CLONE_VFORK | CLONE_PIDFD | SIGCHLD,
+	             &args, pidfd);
+	err  = errno;
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	munmap(stack, SPAWN_STACK_SIZE);
+
+	if (*pid == -1) {
+		*pidfd = -1;
+		return (err == EINVAL || err == ENOSYS || err == EPERM) ? -1 : err;
+	}
+
+	if (args.err) {
+		// exec failed, reap the child
+		waitid(P_PIDFD, *pidfd, NULL, WEXITED);
+		::close(*pidfd);
+		*pidfd = -1;
+		*pid   = -1;
+		return args.err;
+	}
+
+	return 0;
+}
+
+int procepoller::receiver::exited(procepoller &sender, const siginfo_t *info)
+{
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: exited");
+	return -1;
+}
+
+bool procepoller::spawn(const char *path, char *const argv[], char *const envp[], int stdio, size_t pipesize)
+{
+	int ret, i;
+	int fds[3][2] = {{-1, -1}, {-1, -1}, {-1, -1}};
+	int child[3]  = {-1, -1, -1};
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	sigset_t sigs;
+
+	// check process file descriptor
+	if (pidfd != -1) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"child still running");
+		goto unwind;
+	}
+
+	// close pipes left from the previous child
+	in_pipe.close();
+	out_pipe.close();
+	err_pipe.close();
+
+	// the child starts with empty signal mask and default dispositions, signals blocked or ignored by the parent
+	// (e.g. for sigepoller) would not reach it otherwise
+	ret = posix_spawnattr_init(&attr);
+	if (ret) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"spawn attributes initialization failed: %s", strerror(ret));
+		goto unwind;
+	}
+
+	sigemptyset(&sigs);
+	ret = posix_spawnattr_setsigmask(&attr, &sigs);
+	if (!ret) {
+		sigfillset(&sigs);
+		ret = posix_spawnattr_setsigdefault(&attr, &sigs);
+	}
+	if (!ret)
+		ret = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+	if (ret) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"setting spawn attributes failed: %s", strerror(ret));
+		goto unwind_attr;
+	}
+
+	// create pipes and let the child ends be duplicated to standard streams
+	ret = posix_spawn_file_actions_init(&actions);
+	if (ret) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"file actions initialization failed: %s", strerror(ret));
+		goto unwind_attr;
+	}
+
+	for (i = 0; i < 3; ++i) {
+		if (!(stdio & (PROCEPOLLER_STDIN << i)))
+			continue;
+
+		if (pipe2(fds[i], O_CLOEXEC) == -1) {
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"pipe creation failed");
+			goto unwind_pipes;
+		}
+
+		// stdin is read by the child, stdout and stderr are written by the child
+		child[i] = fds[i][i ? 1 : 0];
+		ret = posix_spawn_file_actions_adddup2(&actions, child[i], i);
+		if (ret) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"adding file action failed: %s", strerror(ret));
+			goto unwind_pipes;
+		}
+	}
+
+	// spawn the child with its process file descriptor, so nobody can reap it (by waitpid(-1)) before it is watched
+	ret = clone_spawn(&pid, &pidfd, path, child, argv, envp ? envp : environ);
+	if (ret > 0) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"spawning %s failed: %s", path, strerror(ret));
+		goto unwind_pipes;
+
+	} else if (ret == -1) {
+		// CLONE_PIDFD not supported (or not allowed), so open process file descriptor after spawning
+		ret = posix_spawn(&pid, path, &actions, &attr, argv, envp ? envp : environ);
+		if (ret) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"spawning %s failed: %s", path, strerror(ret));
+			pid = -1;
+			goto unwind_pipes;
+		}
+
+		pidfd = syscall(SYS_pidfd_open, pid, 0);
+		if (pidfd == -1) {
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"process file descriptor creation failed");
+			goto unwind_child;
+		}
+	}
+
+	// close child ends and wrap parent ends (wrapped ones are owned by the pipe epollers)
+	for (i = 0; i < 3; ++i) {
+		if (fds[i][0] == -1)
+			continue;
+
+		::close(fds[i][i ? 1 : 0]);
+		fds[i][i ? 1 : 0] = -1;
+		if (fcntl(fds[i][i ? 0 : 1], F_SETFL, O_NONBLOCK) == -1) {
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting pipe non-blocking failed");
+			goto unwind_pidfd;
+		}
+	}
+
+	if (fds[0][1] != -1) {
+		if (!in_pipe.init(fds[0][1], 0, pipesize, false, false)) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"stdin pipe initialization failed");
+			goto unwind_pidfd;
+		}
+		fds[0][1] = -1;
+	}
+	if (fds[1][0] != -1) {
+		if (!out_pipe.init(fds[1][0], pipesize, 0, true, false)) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"stdout pipe initialization failed");
+			goto unwind_pidfd;
+		}
+		fds[1][0] = -1;
+	}
+	if (fds[2][0] != -1) {
+		if (!err_pipe.init(fds[2][0], pipesize, 0, true, false)) {
+			ELOG(ELOG_ERROR, DBG_PREFIX"stderr pipe initialization failed");
+			goto unwind_pidfd;
+		}
+		fds[2][0] = -1;
+	}
+
+	// add process file descriptor to epoller
+	memset(&event, 0, sizeof event);
+	event.data.ptr = this;
+	event.events = EPOLLIN;
+	if (epoll_ctl(epoller->fd, EPOLL_CTL_ADD, pidfd, &event) == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"adding file descriptor to epoller failed");
+		goto unwind_pidfd;
+	}
+
+	posix_spawn_file_actions_destroy(&actions);
+	posix_spawnattr_destroy(&attr);
+
+	return true;
+
+unwind_pidfd:
+	::close(pidfd);
+	pidfd = -1;
+
+unwind_child:
+	::kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	pid = -1;
+
+unwind_pipes:
+	in_pipe.close();
+	out_pipe.close();
+	err_pipe.close();
+	for (i = 0; i < 3; ++i) {
+		if (fds[i][0] != -1)
+			::close(fds[i][0]);
+		if (fds[i][1] != -1)
+			::close(fds[i][1]);
+	}
+	posix_spawn_file_actions_destroy(&actions);
+
+unwind_attr:
+	posix_spawnattr_destroy(&attr);
+
+unwind:
+	return false;
+}
+
+void procepoller::close_pidfd()
+{
+	// check process file descriptor
+	if (pidfd == -1)
+		return; // already closed
+
+	// remove process file descriptor from epoller
+	if (epoller->fd != -1 && epoll_ctl(epoller->fd, EPOLL_CTL_DEL, pidfd, NULL) == -1)
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"removing file descriptor from epoller failed");
+
+	// close and invalidate process file descriptor
+	::close(pidfd);
+	pidfd = -1;
+}
+
+void procepoller::cleanup()
+{
+	close_pidfd();
+
+	in_pipe.close();
+	out_pipe.close();
+	err_pipe.close();
+}
+
+bool procepoller::kill(int sig)
+{
+	if (pidfd == -1) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"no child running");
+		return false;
+	}
+
+	if (syscall(SYS_pidfd_send_signal, pidfd, sig, NULL, 0) == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"sending signal %d failed", sig);
+		return false;
+	}
+
+	return true;
+}
+
+int procepoller::handler(struct epoller *epoller, struct epoll_event *revent)
+{
+	siginfo_t info;
+
+	if (revent->events & EPOLLIN) {
+		revent->events &= ~EPOLLIN;
+
+		memset(&info, 0, sizeof info);
+		if (waitid(P_PIDFD, pidfd, &info, WEXITED | WNOHANG) == -1) {
+			if (errno != ECHILD) {
+				ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"reaping child failed");
+				close_pidfd();
+				return -1;
+			}
+
+			// reaped by someone else (e.g. by waitpid(-1)), so the exit status is unknown
+			ELOG(ELOG_WARNING, DBG_PREFIX"child %d reaped by someone else, exit status unknown", (int) pid);
+			info.si_signo = SIGCHLD;
+			info.si_pid   = pid;
+			info.si_code  = 0;
+		}
+
+		if (!info.si_pid)
+			return 0; // not exited yet (spurious wake-up)
+
+		close_pidfd();
+		return exited(&info);
+	}
+
+	if (revent->events & EPOLLHUP) {
+		revent->events &= ~EPOLLHUP;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected EPOLLHUP on file descriptor");
+		return -1;
+	}
+
+	if (revent->events & EPOLLERR) {
+		revent->events &= ~EPOLLERR;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected EPOLLERR on file descriptor");
+		return -1;
+	}
+
+	if (revent->events) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected unknown event on file descriptor, events = %u", revent->events);
+		return -1;
+	}
+
+	return 0;
+}
+
+int procepoller::exited(const siginfo_t *info)
+{
+	if (rcvr)
+		return rcvr->exited(*this, info);
+	else if (_exited)
+		return _exited(*this, info);
+	else {
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: exited");
+		return -1;
+	}
+}
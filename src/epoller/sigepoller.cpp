@@ -1,6 +1,6 @@
 #include <epoller/sigepoller.h>
+#include <epoller/log.h>
 #include <unistd.h>
-#include <iostream>
 #include <cstdio>
 #include <cstring>
 
@@ -8,7 +8,7 @@
 
 int sigepoller::receiver::sighandler(sigepoller &sender, struct signalfd_siginfo *siginfo)
 {
-	std::cerr << DBG_PREFIX"unhandled event: sighandler" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: sighandler");
 	return -1;
 }
 
@@ -18,14 +18,17 @@ bool sigepoller::init(const sigset_t *sigset)
 
 	// check file descriptor
 	if (fd != -1) {
-		std::cerr << DBG_PREFIX"already initialized" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"already initialized");
 		goto unwind;
 	}
 
-	// create signal file descriptor
-	fd = signalfd(-1, sigset, 0);
+	// create signal file descriptor (with subscribed signals as well)
+	for (int signo = 1; signo < _NSIG; ++signo)
+		if (sigismember(sigset, signo) == 1)
+			sigaddset(&this->sigset, signo);
+	fd = signalfd(-1, &this->sigset, 0);
 	if (fd == -1) {
-		perror(DBG_PREFIX"file descriptor creation failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"file descriptor creation failed");
 		goto unwind;
 	}
 
@@ -35,7 +38,7 @@ bool sigepoller::init(const sigset_t *sigset)
 	event.events = EPOLLIN;
 	ret = epoll_ctl(epoller->fd, EPOLL_CTL_ADD, fd, &event);
 	if (ret == -1) {
-		perror(DBG_PREFIX"adding file descriptor to epoller failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"adding file descriptor to epoller failed");
 		goto unwind_fd;
 	}
 
@@ -55,56 +58,93 @@ void sigepoller::cleanup()
 	if (fd == -1)
 		return; // already cleaned-up
 
+	// drop signals not dispatched yet
+	if (queued) {
+		epoller->del_flush(this);
+		queued = false;
+	}
+	pending_pos = pending_cnt = 0;
+
 	// remove signal file descriptor from epoller
 	if (epoller->fd != -1 && epoll_ctl(epoller->fd, EPOLL_CTL_DEL, fd, NULL) == -1)
-		perror(DBG_PREFIX"removing file descriptor from epoller failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"removing file descriptor from epoller failed");
 
 	// close and invalidate signal file descriptor
 	close(fd);
 	fd = -1;
 }
 
+bool sigepoller::subscribe(int signo, struct receiver *rcvr)
+{
+	if (signo <= 0 || signo >= _NSIG) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"invalid signal number %d", signo);
+		return false;
+	}
+
+	if (sigismember(&sigset, signo) != 1) {
+		sigaddset(&sigset, signo);
+		if (fd != -1 && signalfd(fd, &sigset, 0) == -1) {
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"updating signal mask of file descriptor failed");
+			sigdelset(&sigset, signo);
+			return false;
+		}
+	}
+
+	routes[signo] = rcvr;
+	return true;
+}
+
 int sigepoller::handler(struct epoller *epoller, struct epoll_event *revent)
 {
 	int ret;
-	struct signalfd_siginfo siginfo;
+	ssize_t len;
+	struct epoller_event **pthis = epoller_event::pthis;
 
 	if (revent->events & EPOLLIN) {
 		revent->events &= ~EPOLLIN;
 
-		ret = read(fd, &siginfo, sizeof siginfo);
-		if (ret == -1) {
-			perror(DBG_PREFIX"reading from file descriptor failed");
-			return -1;
+		// signals left from the previous read go first
+		ret = dispatch();
+		if (ret || !*pthis || fd == -1)
+			return ret;
 
-		} else if (ret == 0) {
-			perror(DBG_PREFIX"no data read from file descriptor");
+		if (siginfos.size() != (batch ? batch : 1))
+			siginfos.resize(batch ? batch : 1);
+
+		len = read(fd, siginfos.data(), siginfos.size() * sizeof siginfos[0]);
+		if (len == -1) {
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"reading from file descriptor failed");
 			return -1;
 
-		} else {
-			if (ret != sizeof siginfo) {
-				perror(DBG_PREFIX"mismatched data read from file descriptor");
-				return -1;
-			}
+		} else if (len == 0) {
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"no data read from file descriptor");
+			return -1;
 
-			return sighandler(&siginfo);
+		} else if (len % sizeof siginfos[0]) {
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"mismatched data read from file descriptor");
+			return -1;
 		}
+
+		pending_pos = 0;
+		pending_cnt = len / sizeof siginfos[0];
+
+		return dispatch();
 	}
 
 	if (revent->events & EPOLLHUP) {
 		revent->events &= ~EPOLLHUP;
-		std::cerr << DBG_PREFIX"unexpected EPOLLHUP on file descriptor" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected EPOLLHUP on file descriptor");
 		return -1;
 	}
 
 	if (revent->events & EPOLLERR) {
 		revent->events &= ~EPOLLERR;
-		std::cerr << DBG_PREFIX"unexpected EPOLLERR on file descriptor" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected EPOLLERR on file descriptor");
 		return -1;
 	}
 
 	if (revent->events) {
-		std::cerr << DBG_PREFIX"unexpected unknown event on file descriptor, events = " << revent->events << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected unknown event on file descriptor, events = %u", revent->events);
 		return -1;
 	}
 
@@ -118,8 +158,44 @@ int sigepoller::sighandler(struct signalfd_siginfo *siginfo)
 	else if (_sighandler)
 		return _sighandler(*this, siginfo);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: sighandler" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: sighandler");
 		return -1;
 	}
 }
 
+int sigepoller::route(struct signalfd_siginfo *siginfo)
+{
+	if (siginfo->ssi_signo < _NSIG && routes[siginfo->ssi_signo])
+		return routes[siginfo->ssi_signo]->sighandler(*this, siginfo);
+
+	return sighandler(siginfo);
+}
+
+int sigepoller::dispatch()
+{
+	int ret;
+	struct epoller_event **pthis = epoller_event::pthis;
+
+	while (pending_pos < pending_cnt) {
+		ret = route(&siginfos[pending_pos++]);
+		if (ret || !*pthis || fd == -1) {
+			// the rest is dispatched just before next epoll_wait (unless the signal epoller is gone)
+			if (*pthis && fd != -1 && pending_pos < pending_cnt && !queued) {
+				queued = true;
+				epoller->add_flush(this);
+			}
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+int sigepoller::flush(struct epoller *epoller, int *timeout)
+{
+	queued = false;
+	if (fd == -1)
+		return 0;
+
+	return dispatch();
+}
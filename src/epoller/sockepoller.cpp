@@ -1,16 +1,23 @@
 #include <epoller/sockepoller.h>
+#include <epoller/log.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <net/if.h>
 #include <netdb.h>
+#include <sys/sendfile.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <cstdio>
-#include <iostream>
 #include <cerrno>
 
 #define DBG_PREFIX "sockepoller: "
 
+int sockepoller::receiver::wmark(sockepoller &sender, bool writable)
+{
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: wmark");
+	return -1;
+}
+
 bool sockepoller::init(int fd, size_t rxsize, size_t txsize, bool rxen, bool txen, bool en)
 {
 	if (this->fd != -1)
@@ -18,6 +25,7 @@ bool sockepoller::init(int fd, size_t rxsize, size_t txsize, bool rxen, bool txe
 
 	rx_flags = 0;
 	tx_flags = 0;
+	tx_writable = true;
 
 	if(!fdepoller::init(fd, rxsize, txsize, rxen, txen, en))
 		return false;
@@ -32,7 +40,7 @@ bool sockepoller::socket(int domain, int type, int protocol, size_t rxsize, size
 
 	int fd = ::socket(domain, type, protocol);
 	if (fd == -1) {
-		perror(DBG_PREFIX"creating socket failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"creating socket failed");
 		return false;
 	}
 
@@ -48,7 +56,7 @@ bool sockepoller::shutdown(int how)
 {
 	int ret = ::shutdown(fd, how);
 	if (ret == -1) {
-		perror(DBG_PREFIX"shutdowning socket failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"shutdowning socket failed");
 		return false;
 	}
 	return true;
@@ -58,7 +66,7 @@ bool sockepoller::listen(int backlog)
 {
 	int ret = ::listen(fd, backlog);
 	if (ret == -1) {
-		perror(DBG_PREFIX"setting socket into passive state failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting socket into passive state failed");
 		return false;
 	}
 	return true;
@@ -75,7 +83,7 @@ bool sockepoller::bind(const std::string &ip, unsigned short port)
 
 	ret = ::bind(fd, (const struct sockaddr *) &addr, addr_len);
 	if (ret == -1) {
-		perror(DBG_PREFIX"binding socket epoller failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"binding socket epoller failed");
 		return false;
 	}
 
@@ -86,7 +94,7 @@ int sockepoller::accept(struct sockaddr *addr, socklen_t *addrlen)
 {
 	int new_fd = ::accept(fd, addr, addrlen);
 	if (new_fd == -1) {
-		perror(DBG_PREFIX"accepting on socket epoller failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"accepting on socket epoller failed");
 		return -1;
 	}
 
@@ -108,12 +116,12 @@ bool sockepoller::connect(const std::string &ip, unsigned short port)
 	ret = ::connect(fd, (const struct sockaddr *) &addr, addr_len);
 	if (flags & O_NONBLOCK) {
 		if (ret == -1 && errno != EINPROGRESS) {
-			perror(DBG_PREFIX"connecting non-blocking socket failed");
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"connecting non-blocking socket failed");
 			return false;
 		}
 	} else {
 		if (ret == -1) {
-			perror(DBG_PREFIX"connecting blocking socket epoller failed");
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"connecting blocking socket epoller failed");
 			return false;
 		}
 	}
@@ -121,17 +129,41 @@ bool sockepoller::connect(const std::string &ip, unsigned short port)
 	return true;
 }
 
+ssize_t sockepoller::connect_fastopen(const std::string &ip, unsigned short port, const void *buff, size_t len)
+{
+	int flags;
+	ssize_t ret;
+	struct sockaddr_storage addr = {};
+	socklen_t addr_len;
+
+	if (!fill_addr_inet(ip, port, &addr, &addr_len))
+		return -1;
+
+	if (!get_flags(&flags))
+		return -1;
+
+	ret = ::sendto(fd, buff, len, tx_flags | MSG_FASTOPEN, (const struct sockaddr *) &addr, addr_len);
+	if (ret == -1) {
+		if ((flags & O_NONBLOCK) && errno == EINPROGRESS)
+			return 0; // no cookie yet, data were not sent
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"fast open connecting socket failed");
+		return -1;
+	}
+
+	return ret;
+}
+
 bool sockepoller::get_so_domain(int *domain)
 {
 	socklen_t len = sizeof(int);
 
 	if (getsockopt(fd, SOL_SOCKET, SO_DOMAIN, domain, &len) == -1) {
-		perror(DBG_PREFIX"getting SO_DOMAIN failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting SO_DOMAIN failed");
 		return false;
 	}
 
 	if (len != sizeof(int)) {
-		std::cerr << DBG_PREFIX"getting SO_DOMAIN failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting SO_DOMAIN failed, wrong length returned");
 		return false;
 	}
 
@@ -143,12 +175,12 @@ bool sockepoller::get_so_type(int *type)
 	socklen_t len = sizeof(int);
 
 	if (getsockopt(fd, SOL_SOCKET, SO_TYPE, type, &len) == -1) {
-		perror(DBG_PREFIX"getting SO_TYPE failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting SO_TYPE failed");
 		return false;
 	}
 
 	if (len != sizeof(int)) {
-		std::cerr << DBG_PREFIX"getting SO_TYPE failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting SO_TYPE failed, wrong length returned");
 		return false;
 	}
 
@@ -160,12 +192,12 @@ bool sockepoller::get_so_error(int *error)
 	socklen_t len = sizeof(int);
 
 	if (getsockopt(fd, SOL_SOCKET, SO_ERROR, error, &len) == -1) {
-		perror(DBG_PREFIX"getting SO_ERROR failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting SO_ERROR failed");
 		return false;
 	}
 
 	if (len != sizeof(int)) {
-		std::cerr << DBG_PREFIX"getting SO_ERROR failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting SO_ERROR failed, wrong length returned");
 		return false;
 	}
 
@@ -175,7 +207,7 @@ bool sockepoller::get_so_error(int *error)
 bool sockepoller::set_so_sndbuf(int value)
 {
 	if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &value, sizeof value) == -1) {
-		perror(DBG_PREFIX"setting SO_SNDBUF failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting SO_SNDBUF failed");
 		return false;
 	}
 
@@ -187,12 +219,12 @@ bool sockepoller::get_so_sndbuf(int *value)
 	socklen_t len = sizeof(int);
 
 	if (getsockopt(fd, SOL_SOCKET, SO_SNDBUF, value, &len) == -1) {
-		perror(DBG_PREFIX"getting SO_SNDBUF failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting SO_SNDBUF failed");
 		return false;
 	}
 
 	if (len != sizeof(int)) {
-		std::cerr << DBG_PREFIX"getting SO_SNDBUF failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting SO_SNDBUF failed, wrong length returned");
 		return false;
 	}
 
@@ -202,7 +234,7 @@ bool sockepoller::get_so_sndbuf(int *value)
 bool sockepoller::set_so_rcvbuf(int value)
 {
 	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &value, sizeof value) == -1) {
-		perror(DBG_PREFIX"setting SO_RCVBUF failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting SO_RCVBUF failed");
 		return false;
 	}
 
@@ -214,12 +246,12 @@ bool sockepoller::get_so_rcvbuf(int *value)
 	socklen_t len = sizeof(int);
 
 	if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, value, &len) == -1) {
-		perror(DBG_PREFIX"getting SO_RCVBUF failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting SO_RCVBUF failed");
 		return false;
 	}
 
 	if (len != sizeof(int)) {
-		std::cerr << DBG_PREFIX"getting SO_RCVBUF failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting SO_RCVBUF failed, wrong length returned");
 		return false;
 	}
 
@@ -233,7 +265,7 @@ bool sockepoller::set_so_linger(bool enabled, int timeout)
 	linger.l_onoff = enabled;
 	linger.l_linger = timeout;
 	if (setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof linger) == -1) {
-		perror(DBG_PREFIX"setting SO_LINGER failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting SO_LINGER failed");
 		return false;
 	}
 
@@ -246,12 +278,12 @@ bool sockepoller::get_so_linger(bool *enabled, int *timeout)
 	socklen_t len = sizeof linger;
 
 	if (getsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, &len) == -1) {
-		perror(DBG_PREFIX"getting SO_LINGER failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting SO_LINGER failed");
 		return false;
 	}
 
 	if (len != sizeof linger) {
-		std::cerr << DBG_PREFIX"getting SO_LINGER failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting SO_LINGER failed, wrong length returned");
 		return false;
 	}
 
@@ -266,7 +298,7 @@ bool sockepoller::set_so_reuseaddr(bool enabled)
 	int reuse = enabled;
 
 	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof reuse) == -1) {
-		perror(DBG_PREFIX"setting SO_REUSEADDR failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting SO_REUSEADDR failed");
 		return false;
 	}
 
@@ -279,12 +311,12 @@ bool sockepoller::get_so_reuseaddr(bool *enabled)
 	socklen_t len = sizeof reuse;
 
 	if (getsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, &len) == -1) {
-		perror(DBG_PREFIX"getting SO_REUSEADDR failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting SO_REUSEADDR failed");
 		return false;
 	}
 
 	if (len != sizeof reuse) {
-		std::cerr << DBG_PREFIX"getting SO_REUSEADDR failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting SO_REUSEADDR failed, wrong length returned");
 		return false;
 	}
 
@@ -298,7 +330,7 @@ bool sockepoller::set_so_keepalive(bool enabled)
 	int keep = enabled;
 
 	if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &keep, sizeof keep) == -1) {
-		perror(DBG_PREFIX"setting SO_KEEPALIVE failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting SO_KEEPALIVE failed");
 		return false;
 	}
 
@@ -311,12 +343,12 @@ bool sockepoller::get_so_keepalive(bool *enabled)
 	socklen_t len = sizeof keep;
 
 	if (getsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &keep, &len) == -1) {
-		perror(DBG_PREFIX"getting SO_KEEPALIVE failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting SO_KEEPALIVE failed");
 		return false;
 	}
 
 	if (len != sizeof keep) {
-		std::cerr << DBG_PREFIX"getting SO_KEEPALIVE failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting SO_KEEPALIVE failed, wrong length returned");
 		return false;
 	}
 
@@ -330,7 +362,7 @@ bool sockepoller::set_so_broadcast(bool enabled)
 	int broadcast = enabled;
 
 	if (setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof broadcast) == -1) {
-		perror(DBG_PREFIX"setting SO_BROADCAST failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting SO_BROADCAST failed");
 		return false;
 	}
 
@@ -343,12 +375,12 @@ bool sockepoller::get_so_broadcast(bool *enabled)
 	socklen_t len = sizeof broadcast;
 
 	if (getsockopt(fd, SOL_SOCKET, SO_BROADCAST, &broadcast, &len) == -1) {
-		perror(DBG_PREFIX"getting SO_BROADCAST failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting SO_BROADCAST failed");
 		return false;
 	}
 
 	if (len != sizeof broadcast) {
-		std::cerr << DBG_PREFIX"getting SO_BROADCAST failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting SO_BROADCAST failed, wrong length returned");
 		return false;
 	}
 
@@ -360,7 +392,7 @@ bool sockepoller::get_so_broadcast(bool *enabled)
 bool sockepoller::set_so_bindtodevice(const std::string &dev)
 {
 	if (setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, dev.c_str(), dev.length()) == -1) {
-		perror(DBG_PREFIX"setting SO_BINDTODEVICE failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting SO_BINDTODEVICE failed");
 		return false;
 	}
 
@@ -373,7 +405,7 @@ bool sockepoller::get_so_bindtodevice(std::string *dev)
 	socklen_t len = IFNAMSIZ;
 
 	if (getsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, _dev, &len) == -1) {
-		perror(DBG_PREFIX"getting SO_BINDTODEVICE failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting SO_BINDTODEVICE failed");
 		return false;
 	}
 
@@ -386,7 +418,7 @@ bool sockepoller::get_so_bindtodevice(std::string *dev)
 bool sockepoller::set_so_rcvtimeo(const struct timeval *timeout)
 {
 	if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, timeout, sizeof(struct timeval)) == -1) {
-		perror(DBG_PREFIX"setting SO_RCVTIMEO failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting SO_RCVTIMEO failed");
 		return false;
 	}
 
@@ -397,12 +429,12 @@ bool sockepoller::get_so_rcvtimeo(struct timeval *timeout)
 {
 	socklen_t len = sizeof(struct timeval);
 	if (getsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, timeout, &len) == -1) {
-		perror(DBG_PREFIX"getting SO_RCVTIMEO failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting SO_RCVTIMEO failed");
 		return false;
 	}
 
 	if (len != sizeof(struct timeval)) {
-		std::cerr << DBG_PREFIX"getting SO_RCVTIMEO failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting SO_RCVTIMEO failed, wrong length returned");
 		return false;
 	}
 
@@ -412,7 +444,7 @@ bool sockepoller::get_so_rcvtimeo(struct timeval *timeout)
 bool sockepoller::set_so_sndtimeo(const struct timeval *timeout)
 {
 	if (setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, timeout, sizeof(struct timeval)) == -1) {
-		perror(DBG_PREFIX"setting SO_SNDTIMEO failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting SO_SNDTIMEO failed");
 		return false;
 	}
 
@@ -423,12 +455,12 @@ bool sockepoller::get_so_sndtimeo(struct timeval *timeout)
 {
 	socklen_t len = sizeof(struct timeval);
 	if (getsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, timeout, &len) == -1) {
-		perror(DBG_PREFIX"getting SO_SNDTIMEO failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting SO_SNDTIMEO failed");
 		return false;
 	}
 
 	if (len != sizeof(struct timeval)) {
-		std::cerr << DBG_PREFIX"getting SO_SNDTIMEO failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting SO_SNDTIMEO failed, wrong length returned");
 		return false;
 	}
 
@@ -440,7 +472,7 @@ bool sockepoller::set_so_tcp_nodelay(bool enabled)
 	int nodelay = enabled;
 
 	if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof nodelay) == -1) {
-		perror(DBG_PREFIX"setting TCP_NODELAY failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting TCP_NODELAY failed");
 		return false;
 	}
 
@@ -453,12 +485,12 @@ bool sockepoller::get_so_tcp_nodelay(bool *enabled)
 	socklen_t len = sizeof nodelay;
 
 	if (getsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, &len) == -1) {
-		perror(DBG_PREFIX"getting TCP_NODELAY failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting TCP_NODELAY failed");
 		return false;
 	}
 
 	if (len != sizeof nodelay) {
-		std::cerr << DBG_PREFIX"getting TCP_NODELAY failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting TCP_NODELAY failed, wrong length returned");
 		return false;
 	}
 
@@ -472,7 +504,7 @@ bool sockepoller::set_so_tcp_cork(bool enabled)
 	int cork = enabled;
 
 	if (setsockopt(fd, IPPROTO_TCP, TCP_CORK, &cork, sizeof cork) == -1) {
-		perror(DBG_PREFIX"setting TCP_CORK failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting TCP_CORK failed");
 		return false;
 	}
 
@@ -485,12 +517,12 @@ bool sockepoller::get_so_tcp_cork(bool *enabled)
 	socklen_t len = sizeof cork;
 
 	if (getsockopt(fd, IPPROTO_TCP, TCP_CORK, &cork, &len) == -1) {
-		perror(DBG_PREFIX"getting TCP_CORK failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting TCP_CORK failed");
 		return false;
 	}
 
 	if (len != sizeof cork) {
-		std::cerr << DBG_PREFIX"getting TCP_CORK failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting TCP_CORK failed, wrong length returned");
 		return false;
 	}
 
@@ -502,7 +534,7 @@ bool sockepoller::get_so_tcp_cork(bool *enabled)
 bool sockepoller::set_so_tcp_keepidle(int value)
 {
 	if (setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &value, sizeof value) == -1) {
-		perror(DBG_PREFIX"setting TCP_KEEPIDLE failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting TCP_KEEPIDLE failed");
 		return false;
 	}
 
@@ -514,12 +546,12 @@ bool sockepoller::get_so_tcp_keepidle(int *value)
 	socklen_t len = sizeof(int);
 
 	if (getsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, value, &len) == -1) {
-		perror(DBG_PREFIX"getting TCP_KEEPIDLE failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting TCP_KEEPIDLE failed");
 		return false;
 	}
 
 	if (len != sizeof(int)) {
-		std::cerr << DBG_PREFIX"getting TCP_KEEPIDLE failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting TCP_KEEPIDLE failed, wrong length returned");
 		return false;
 	}
 
@@ -529,7 +561,7 @@ bool sockepoller::get_so_tcp_keepidle(int *value)
 bool sockepoller::set_so_tcp_keepintvl(int value)
 {
 	if (setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &value, sizeof value) == -1) {
-		perror(DBG_PREFIX"setting TCP_KEEPINTVL failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting TCP_KEEPINTVL failed");
 		return false;
 	}
 
@@ -541,12 +573,12 @@ bool sockepoller::get_so_tcp_keepintvl(int *value)
 	socklen_t len = sizeof(int);
 
 	if (getsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, value, &len) == -1) {
-		perror(DBG_PREFIX"getting TCP_KEEPINTVL failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting TCP_KEEPINTVL failed");
 		return false;
 	}
 
 	if (len != sizeof(int)) {
-		std::cerr << DBG_PREFIX"getting TCP_KEEPINTVL failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting TCP_KEEPINTVL failed, wrong length returned");
 		return false;
 	}
 
@@ -556,7 +588,7 @@ bool sockepoller::get_so_tcp_keepintvl(int *value)
 bool sockepoller::set_so_tcp_keepcnt(int value)
 {
 	if (setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &value, sizeof value) == -1) {
-		perror(DBG_PREFIX"setting TCP_KEEPCNT failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting TCP_KEEPCNT failed");
 		return false;
 	}
 
@@ -568,12 +600,12 @@ bool sockepoller::get_so_tcp_keepcnt(int *value)
 	socklen_t len = sizeof(int);
 
 	if (getsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, value, &len) == -1) {
-		perror(DBG_PREFIX"getting TCP_KEEPCNT failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting TCP_KEEPCNT failed");
 		return false;
 	}
 
 	if (len != sizeof(int)) {
-		std::cerr << DBG_PREFIX"getting TCP_KEEPCNT failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting TCP_KEEPCNT failed, wrong length returned");
 		return false;
 	}
 
@@ -583,7 +615,7 @@ bool sockepoller::get_so_tcp_keepcnt(int *value)
 bool sockepoller::set_so_tcp_maxseg(int value)
 {
 	if (setsockopt(fd, IPPROTO_TCP, TCP_MAXSEG, &value, sizeof value) == -1) {
-		perror(DBG_PREFIX"setting TCP_MAXSEG failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting TCP_MAXSEG failed");
 		return false;
 	}
 
@@ -595,12 +627,12 @@ bool sockepoller::get_so_tcp_maxseg(int *value)
 	socklen_t len = sizeof(int);
 
 	if (getsockopt(fd, IPPROTO_TCP, TCP_MAXSEG, value, &len) == -1) {
-		perror(DBG_PREFIX"getting TCP_MAXSEG failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting TCP_MAXSEG failed");
 		return false;
 	}
 
 	if (len != sizeof(int)) {
-		std::cerr << DBG_PREFIX"getting TCP_MAXSEG failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting TCP_MAXSEG failed, wrong length returned");
 		return false;
 	}
 
@@ -610,7 +642,7 @@ bool sockepoller::get_so_tcp_maxseg(int *value)
 bool sockepoller::set_so_tcp_syncnt(int value)
 {
 	if (setsockopt(fd, IPPROTO_TCP, TCP_SYNCNT, &value, sizeof value) == -1) {
-		perror(DBG_PREFIX"setting TCP_SYNCNT failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting TCP_SYNCNT failed");
 		return false;
 	}
 
@@ -622,12 +654,98 @@ bool sockepoller::get_so_tcp_syncnt(int *value)
 	socklen_t len = sizeof(int);
 
 	if (getsockopt(fd, IPPROTO_TCP, TCP_SYNCNT, value, &len) == -1) {
-		perror(DBG_PREFIX"getting TCP_SYNCNT failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting TCP_SYNCNT failed");
+		return false;
+	}
+
+	if (len != sizeof(int)) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting TCP_SYNCNT failed, wrong length returned");
+		return false;
+	}
+
+	return true;
+}
+
+bool sockepoller::set_so_tcp_fastopen(int value)
+{
+	if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &value, sizeof value) == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting TCP_FASTOPEN failed");
+		return false;
+	}
+
+	return true;
+}
+
+bool sockepoller::get_so_tcp_fastopen(int *value)
+{
+	socklen_t len = sizeof(int);
+
+	if (getsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, value, &len) == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting TCP_FASTOPEN failed");
+		return false;
+	}
+
+	if (len != sizeof(int)) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting TCP_FASTOPEN failed, wrong length returned");
+		return false;
+	}
+
+	return true;
+}
+
+bool sockepoller::set_so_tcp_fastopen_connect(bool enabled)
+{
+	int fastopen = enabled;
+
+	if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &fastopen, sizeof fastopen) == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting TCP_FASTOPEN_CONNECT failed");
+		return false;
+	}
+
+	return true;
+}
+
+bool sockepoller::get_so_tcp_fastopen_connect(bool *enabled)
+{
+	int fastopen;
+	socklen_t len = sizeof fastopen;
+
+	if (getsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &fastopen, &len) == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting TCP_FASTOPEN_CONNECT failed");
+		return false;
+	}
+
+	if (len != sizeof fastopen) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting TCP_FASTOPEN_CONNECT failed, wrong length returned");
+		return false;
+	}
+
+	*enabled = fastopen;
+
+	return true;
+}
+
+bool sockepoller::set_so_tcp_notsent_lowat(int value)
+{
+	if (setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &value, sizeof value) == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting TCP_NOTSENT_LOWAT failed");
+		return false;
+	}
+
+	return true;
+}
+
+bool sockepoller::get_so_tcp_notsent_lowat(int *value)
+{
+	socklen_t len = sizeof(int);
+
+	if (getsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, value, &len) == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting TCP_NOTSENT_LOWAT failed");
 		return false;
 	}
 
 	if (len != sizeof(int)) {
-		std::cerr << DBG_PREFIX"getting TCP_SYNCNT failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting TCP_NOTSENT_LOWAT failed, wrong length returned");
 		return false;
 	}
 
@@ -639,12 +757,12 @@ bool sockepoller::get_so_tcp_info(struct tcp_info *tcp_info)
 	socklen_t len = sizeof(struct tcp_info);
 
 	if (getsockopt(fd, SOL_TCP, TCP_INFO, tcp_info, &len) == -1) {
-		perror(DBG_PREFIX"getting TCP_INFO failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting TCP_INFO failed");
 		return false;
 	}
 
 	if (len != sizeof(struct tcp_info)) {
-		std::cerr << DBG_PREFIX"getting TCP_INFO failed, wrong length returned" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"getting TCP_INFO failed, wrong length returned");
 		return false;
 	}
 
@@ -669,23 +787,86 @@ bool sockepoller::fill_addr_inet(const std::string &ip, unsigned short port, str
 		*addr_len = sizeof(struct sockaddr_in6);
 
 	} else {
-		std::cerr << DBG_PREFIX"unsupported socket domain" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unsupported socket domain");
+		return false;
+	}
+
+	return true;
+}
+
+bool sockepoller::set_backpressure(int notsent_lowat, size_t lowat, size_t hiwat)
+{
+	if (hiwat && lowat >= hiwat) {
+		ELOG(ELOG_ERROR, DBG_PREFIX"low watermark must be lower than high watermark");
 		return false;
 	}
 
+	if (notsent_lowat > 0 && !set_so_tcp_notsent_lowat(notsent_lowat))
+		return false;
+
+	tx_lowat = lowat;
+	tx_hiwat = hiwat;
+	tx_writable = true;
+
 	return true;
 }
 
+int sockepoller::wmark(bool writable)
+{
+	if (rcvr)
+		return dynamic_cast<receiver *>(rcvr)->wmark(*this, writable);
+	else if (_wmark)
+		return _wmark(*this, writable);
+	else {
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: wmark");
+		return -1;
+	}
+}
+
+ssize_t sockepoller::write_stream(const void *buff, size_t len)
+{
+	int r;
+	ssize_t ret = fdepoller::write_stream(buff, len);
+
+	if (ret >= 0 && tx_hiwat && tx_writable && linbuff_tord(&txbuff) >= tx_hiwat) {
+		tx_writable = false;
+		if ((r = wmark(false)))
+			epoller->exit(r);
+	}
+
+	return ret;
+}
+
+int sockepoller::flush(struct epoller *epoller, int *timeout)
+{
+	int ret;
+	struct epoller_event **pthis = epoller_event::pthis;
+
+	if ((ret = fdepoller::flush(epoller, timeout)) || (pthis && !*pthis) || fd == -1)
+		return ret;
+
+	if (tx_writable || linbuff_tord(&txbuff) > tx_lowat)
+		return 0;
+
+	tx_writable = true;
+	return wmark(true);
+}
+
+ssize_t sockepoller::send_file(int in_fd, off_t *offset, size_t len)
+{
+	return sendfile(fd, in_fd, offset, len);
+}
+
 int sockepoller::epoll_in()
 {
 	int ret = recv(fd, LINBUFF_WR_PTR(&rxbuff), linbuff_towr(&rxbuff), rx_flags);
 
 	if (ret < -1) {
-		perror(DBG_PREFIX"reading from file descriptor failed (unexpected retvalue)");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"reading from file descriptor failed (unexpected retvalue)");
 		return rx(-1);
 
 	} else if (ret == -1) {
-		perror(DBG_PREFIX"reading from file descriptor failed");
+		ELOG_ERRNO(errno == EAGAIN ? ELOG_DEBUG : ELOG_ERROR, DBG_PREFIX"reading from file descriptor failed");
 		return rx(-1);
 
 	} else if (ret == 0) {
@@ -693,28 +874,45 @@ int sockepoller::epoll_in()
 
 	} else {
 		linbuff_forward(&rxbuff, ret);
+		rx_charge(ret);
 		return rx(ret);
 	}
 }
 
 int sockepoller::epoll_out()
 {
-	int ret = send(fd, LINBUFF_RD_PTR(&txbuff), linbuff_tord(&txbuff), tx_flags);
+	// corked data are written by flush, which enables transmitting again if they are not written at once
+	if (tx_corked)
+		return disable_tx() ? 0 : -1;
+
+	if (!txfiles.empty() && !txfiles.front().before)
+		return epoll_out_file();
+
+	int ret = send(fd, LINBUFF_RD_PTR(&txbuff), tx_chunk(), tx_flags);
 
 	if (ret < -1) {
-		perror(DBG_PREFIX"writing to file descriptor failed (unexpected retvalue)");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"writing to file descriptor failed (unexpected retvalue)");
 		return tx(-1);
 
 	} else if (ret == -1) {
-		perror(DBG_PREFIX"writing to file descriptor failed");
+		ELOG_ERRNO(errno == EAGAIN ? ELOG_DEBUG : ELOG_ERROR, DBG_PREFIX"writing to file descriptor failed");
 		return tx(-1);
 
 	} else if (ret == 0) {
 		return tx(0);
 
 	} else {
-		linbuff_skip(&txbuff, ret);
-		return tx(ret);
+		struct epoller_event **pthis = epoller_event::pthis;
+
+		tx_skip(ret);
+		if (tx_writable || linbuff_tord(&txbuff) > tx_lowat)
+			return tx(ret);
+
+		if ((ret = tx(ret)) || (pthis && !*pthis) || fd == -1)
+			return ret;
+
+		tx_writable = true;
+		return wmark(true);
 	}
 }
 
@@ -840,10 +1038,10 @@ bool sockepoller::fill_addr_inet4(const std::string &ip, unsigned short port, st
 	else {
 		int ret = inet_pton(AF_INET, ip.c_str(), &(addr->sin_addr));
 		if (ret == 0) {
-			std::cerr << DBG_PREFIX"converting IPv4 address failed, invalid network address" << std::endl;
+			ELOG(ELOG_ERROR, DBG_PREFIX"converting IPv4 address failed, invalid network address");
 			return false;
 		 } else if (ret == -1) {
-			perror(DBG_PREFIX"converting IPv4 address failed");
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"converting IPv4 address failed");
 			return false;
 		 }
 	}
@@ -860,10 +1058,10 @@ bool sockepoller::fill_addr_inet6(const std::string &ip, unsigned short port, st
 	else {
 		int ret = inet_pton(AF_INET6, ip.c_str(), &(addr->sin6_addr));
 		if (ret == 0) {
-			std::cerr << DBG_PREFIX"converting IPv6 address failed, invalid network address" << std::endl;
+			ELOG(ELOG_ERROR, DBG_PREFIX"converting IPv6 address failed, invalid network address");
 			return false;
 		 } else if (ret == -1) {
-			perror(DBG_PREFIX"converting IPv6 address failed");
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"converting IPv6 address failed");
 			return false;
 		 }
 	}
@@ -1,12 +1,12 @@
 #include <epoller/tcpcepoller.h>
+#include <epoller/log.h>
 #include <fcntl.h>
-#include <iostream>
 
 #define DBG_PREFIX "tcpcepoller: "
 
 int tcpcepoller::receiver::con(tcpcepoller &sender, bool connected)
 {
-	std::cerr << DBG_PREFIX"unhandled event: con" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: con");
 	return -1;
 }
 
@@ -29,7 +29,16 @@ bool tcpcepoller::connect(const std::string &ip, unsigned short port)
 	if (!sockepoller::enable(false, true, false))
 		return false;
 
-	if (!sockepoller::connect(ip, port)) {
+	if (fastopen && linbuff_tord(&txbuff)) {
+		ssize_t ret = sockepoller::connect_fastopen(ip, port, LINBUFF_RD_PTR(&txbuff), linbuff_tord(&txbuff));
+		if (ret == -1) {
+			sockepoller::disable();
+			return false;
+		}
+		linbuff_skip(&txbuff, ret);
+		linbuff_compact(&txbuff);
+
+	} else if (!sockepoller::connect(ip, port)) {
 		sockepoller::disable();
 		return false;
 	}
@@ -46,7 +55,7 @@ int tcpcepoller::con(bool connected)
 	else if (_con)
 		return _con(*this, connected);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: con" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: con");
 		return -1;
 	}
 }
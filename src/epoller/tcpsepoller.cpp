@@ -1,15 +1,16 @@
 #include <epoller/tcpsepoller.h>
+#include <epoller/log.h>
 #include <fcntl.h>
 
 #define DBG_PREFIX "tcpsepoller: "
 
 int tcpsepoller::receiver::acc(tcpsepoller &sender, int fd, const struct sockaddr *addr, const socklen_t *addrlen)
 {
-	std::cerr << DBG_PREFIX"unhandled event: acc" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: acc");
 	return -1;
 }
 
-bool tcpsepoller::socket(int domain, const std::string &ip, unsigned short port, int backlog, bool reuseaddr)
+bool tcpsepoller::socket(int domain, const std::string &ip, unsigned short port, int backlog, bool reuseaddr, int fastopen)
 {
 	if (fd != -1)
 		return true;
@@ -27,6 +28,11 @@ bool tcpsepoller::socket(int domain, const std::string &ip, unsigned short port,
 		return false;
 	}
 
+	if (fastopen > 0 && !set_so_tcp_fastopen(fastopen)) {
+		close();
+		return false;
+	}
+
 	if (!listen(backlog)) {
 		close();
 		return false;
@@ -42,7 +48,7 @@ int tcpsepoller::acc(int fd, const struct sockaddr *addr, const socklen_t *addrl
 	else if (_acc)
 		return _acc(*this, fd, addr, addrlen);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: acc" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: acc");
 		return -1;
 	}
 }
@@ -1,6 +1,6 @@
 #include <epoller/timepoller.h>
+#include <epoller/log.h>
 #include <unistd.h>
-#include <iostream>
 #include <cstdio>
 #include <cstring>
 
@@ -8,7 +8,7 @@
 
 int timepoller::receiver::timerhandler(timepoller &sender, uint64_t exp)
 {
-	std::cerr << DBG_PREFIX"unhandled event: timerhandler" << std::endl;
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: timerhandler");
 	return -1;
 }
 
@@ -18,14 +18,14 @@ bool timepoller::init(int clockid)
 
 	// check file descriptor
 	if (fd != -1) {
-		std::cerr << DBG_PREFIX"already initialized" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"already initialized");
 		goto unwind;
 	}
 
 	// create timer file descriptor
 	fd = timerfd_create(clockid, 0);
 	if (fd == -1) {
-		perror(DBG_PREFIX"file descriptor creation failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"file descriptor creation failed");
 		goto unwind;
 	}
 
@@ -35,7 +35,7 @@ bool timepoller::init(int clockid)
 	event.events = EPOLLIN;
 	ret = epoll_ctl(epoller->fd, EPOLL_CTL_ADD, fd, &event);
 	if (ret == -1) {
-		perror(DBG_PREFIX"adding file descriptor to epoller failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"adding file descriptor to epoller failed");
 		goto unwind_fd;
 	}
 
@@ -59,8 +59,8 @@ void timepoller::cleanup()
 	disarm();
 
 	// remove timer file descriptor from epoller
-	if (epoller->fd != -1 && epoll_ctl(epoller->fd, EPOLL_CTL_DEL, fd, NULL) == -1)
-		perror(DBG_PREFIX"removing file descriptor from epoller failed");
+	if (epoller && epoller->fd != -1 && epoll_ctl(epoller->fd, EPOLL_CTL_DEL, fd, NULL) == -1)
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"removing file descriptor from epoller failed");
 
 	// close and invalidate timer file descriptor
 	close(fd);
@@ -71,7 +71,7 @@ bool timepoller::settime(int flags, const struct itimerspec *new_value, struct i
 {
 	int ret = timerfd_settime(fd, flags, new_value, old_value);
 	if (ret == -1) {
-		perror(DBG_PREFIX"setting file descriptor properties failed (settime)");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting file descriptor properties failed (settime)");
 		return false;
 	} else
 		return true;
@@ -81,7 +81,7 @@ bool timepoller::gettime(struct itimerspec *curr_value)
 {
 	int ret = timerfd_gettime(fd, curr_value);
 	if (ret == -1) {
-		perror(DBG_PREFIX"getting file descriptor properties failed (gettime)");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting file descriptor properties failed (gettime)");
 		return false;
 	} else
 		return true;
@@ -94,7 +94,7 @@ bool timepoller::arm_oneshot(const struct timespec *val, int flags)
 
 	int ret = timerfd_settime(fd, flags, &spec, NULL);
 	if (ret == -1) {
-		perror(DBG_PREFIX"setting file descriptor properties failed (arm_oneshot)");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting file descriptor properties failed (arm_oneshot)");
 		return false;
 	} else
 		return true;
@@ -126,7 +126,7 @@ bool timepoller::arm_periodic(const struct timespec *val, const struct timespec
 
 	int ret = timerfd_settime(fd, flags, &spec, NULL);
 	if (ret == -1) {
-		perror(DBG_PREFIX"setting file descriptor properties failed (arm_periodic)");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting file descriptor properties failed (arm_periodic)");
 		return false;
 	} else
 		return true;
@@ -172,7 +172,7 @@ bool timepoller::arm(const struct itimerspec *val, int flags)
 {
 	int ret = timerfd_settime(fd, flags, val, NULL);
 	if (ret == -1) {
-		perror(DBG_PREFIX"setting file descriptor properties failed (arm)");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting file descriptor properties failed (arm)");
 		return false;
 	} else
 		return true;
@@ -184,12 +184,47 @@ bool timepoller::disarm()
 
 	int ret = timerfd_settime(fd, 0, &spec, NULL);
 	if (ret == -1) {
-		perror(DBG_PREFIX"setting file descriptor properties failed (disarm)");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting file descriptor properties failed (disarm)");
 		return false;
 	} else
 		return true;
 }
 
+bool timepoller::detach()
+{
+	if (fd == -1 || !epoller)
+		return false;
+
+	if (epoller->fd != -1 && epoll_ctl(epoller->fd, EPOLL_CTL_DEL, fd, NULL) == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"removing file descriptor from epoller failed");
+		return false;
+	}
+
+	// stop the handler, if running
+	if (pthis) {
+		*pthis = 0;
+		pthis  = 0;
+	}
+
+	epoller = 0;
+	return true;
+}
+
+bool timepoller::attach(struct epoller *epoller)
+{
+	if (fd == -1 || this->epoller)
+		return false;
+
+	event.data.ptr = this;
+	if (epoll_ctl(epoller->fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"adding file descriptor to epoller failed");
+		return false;
+	}
+
+	this->epoller = epoller;
+	return true;
+}
+
 int timepoller::handler(struct epoller *epoller, struct epoll_event *revent)
 {
 	int ret;
@@ -200,16 +235,16 @@ int timepoller::handler(struct epoller *epoller, struct epoll_event *revent)
 
 		ret = read(fd, &exp, sizeof exp);
 		if (ret == -1) {
-			perror(DBG_PREFIX"reading from file descriptor failed");
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"reading from file descriptor failed");
 			return -1;
 
 		} else if (ret == 0) {
-			perror(DBG_PREFIX"no data read from file descriptor");
+			ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"no data read from file descriptor");
 			return -1;
 
 		} else {
 			if (ret != sizeof exp) {
-				perror(DBG_PREFIX"mismatched data read from file descriptor");
+				ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"mismatched data read from file descriptor");
 				return -1;
 			}
 
@@ -219,18 +254,18 @@ int timepoller::handler(struct epoller *epoller, struct epoll_event *revent)
 
 	if (revent->events & EPOLLHUP) {
 		revent->events &= ~EPOLLHUP;
-		std::cerr << DBG_PREFIX"unexpected EPOLLHUP on file descriptor" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected EPOLLHUP on file descriptor");
 		return -1;
 	}
 
 	if (revent->events & EPOLLERR) {
 		revent->events &= ~EPOLLERR;
-		std::cerr << DBG_PREFIX"unexpected EPOLLERR on file descriptor" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected EPOLLERR on file descriptor");
 		return -1;
 	}
 
 	if (revent->events) {
-		std::cerr << DBG_PREFIX"unexpected unknown event on file descriptor, events = " << revent->events << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"unexpected unknown event on file descriptor, events = %u", revent->events);
 		return -1;
 	}
 
@@ -244,7 +279,7 @@ int timepoller::timerhandler(uint64_t exp)
 	else if (_timerhandler)
 		return _timerhandler(*this, exp);
 	else {
-		std::cerr << DBG_PREFIX"unhandled event: timerhandler" << std::endl;
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: timerhandler");
 		return -1;
 	}
 }
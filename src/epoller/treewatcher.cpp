@@ -0,0 +1,468 @@
+#include <epoller/treewatcher.h>
+#include <epoller/log.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#define DBG_PREFIX "treewatcher: "
+
+/// @brief Events needed to maintain the tree (added to the reported ones).
+#define TREEWATCHER_WATCH_MASK (IN_CREATE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW)
+
+int treewatcher::receiver::changed(treewatcher &sender, uint32_t mask, const std::string &path)
+{
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: changed");
+	return -1;
+}
+
+int treewatcher::receiver::moved(treewatcher &sender, uint32_t mask, const std::string &from, const std::string &to)
+{
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: moved");
+	return -1;
+}
+
+int treewatcher::receiver::lost(treewatcher &sender)
+{
+	ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: lost");
+	return -1;
+}
+
+void treewatcher::cleanup()
+{
+	// watches are removed with the inotify file descriptor
+	if (top)
+		del_node(top, false);
+	unwatch();
+
+	inotepoller::cleanup();
+}
+
+bool treewatcher::watch(const std::string &root, unsigned int threads)
+{
+	int wd;
+
+	unwatch();
+
+	wd = inotify_add_watch(fd, root.c_str(), mask | TREEWATCHER_WATCH_MASK);
+	if (wd == -1) {
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"adding watch for %s failed", root.c_str());
+		return false;
+	}
+
+	this->root = root;
+	top = add_node(wd, 0, std::string());
+
+	if (!threads)
+		threads = std::max(std::thread::hardware_concurrency(), 1u);
+	scan(top, threads, 0);
+
+	return true;
+}
+
+void treewatcher::unwatch()
+{
+	moving = false;
+
+	if (top)
+		del_node(top, true);
+
+	// drop nodes detached from the tree (if any)
+	for (auto &it : nodes)
+		delete it.second;
+	nodes.clear();
+	children.clear();
+	names.clear();
+}
+
+std::string treewatcher::path(const struct node *n, const char *name) const
+{
+	std::vector<const std::string*> parts;
+	std::string p;
+
+	for (; n && n->parent; n = n->parent)
+		parts.push_back(n->name);
+
+	for (auto it = parts.rbegin(); it != parts.rend(); ++it) {
+		p += **it;
+		p += '/';
+	}
+
+	if (name)
+		p += name;
+	else if (!p.empty())
+		p.pop_back();
+
+	return p;
+}
+
+const std::string *treewatcher::intern(const std::string &name)
+{
+	std::unordered_map<std::string, unsigned int>::iterator it = names.insert(std::make_pair(name, 0u)).first;
+
+	it->second++;
+	return &it->first;
+}
+
+void treewatcher::release(const std::string *name)
+{
+	std::unordered_map<std::string, unsigned int>::iterator it = names.find(*name);
+
+	if (it != names.end() && !--it->second)
+		names.erase(it);
+}
+
+struct treewatcher::node *treewatcher::add_node(int wd, struct node *parent, const std::string &name)
+{
+	struct node *n;
+
+	if (nodes.count(wd))
+		return 0; // already watched (e.g. reached twice)
+
+	n = new struct node;
+	n->wd       = wd;
+	n->parent   = parent;
+	n->name     = intern(name);
+	n->children = 0;
+	n->prev     = 0;
+	n->next     = 0;
+
+	if (parent) {
+		n->next = parent->children;
+		if (n->next)
+			n->next->prev = n;
+		parent->children = n;
+		children[child_key(parent, n->name)] = n;
+	}
+
+	nodes[wd] = n;
+	return n;
+}
+
+void treewatcher::del_node(struct node *n, bool rm)
+{
+	std::unordered_map<child_key, struct node*, child_hash>::iterator it;
+
+	while (n->children)
+		del_node(n->children, rm);
+
+	if (n->parent) {
+		if (n->prev)
+			n->prev->next = n->next;
+		else
+			n->parent->children = n->next;
+		if (n->next)
+			n->next->prev = n->prev;
+
+		// the key may already belong to another directory moved over this one
+		it = children.find(child_key(n->parent, n->name));
+		if (it != children.end() && it->second == n)
+			children.erase(it);
+	}
+
+	if (rm && fd != -1 && inotify_rm_watch(fd, n->wd) == -1)
+		ELOG_ERRNO(ELOG_DEBUG, DBG_PREFIX"removing watch failed");
+
+	nodes.erase(n->wd);
+	release(n->name);
+	if (n == top)
+		top = 0;
+	delete n;
+}
+
+void treewatcher::move_node(struct node *n, struct node *parent, const std::string &name)
+{
+	std::unordered_map<child_key, struct node*, child_hash>::iterator it;
+	const std::string *old;
+
+	// unlink from the old parent
+	if (n->prev)
+		n->prev->next = n->next;
+	else
+		n->parent->children = n->next;
+	if (n->next)
+		n->next->prev = n->prev;
+
+	it = children.find(child_key(n->parent, n->name));
+	if (it != children.end() && it->second == n)
+		children.erase(it);
+
+	// link to the new parent (the new name is interned before the old one is released, they may be the same)
+	old       = n->name;
+	n->parent = parent;
+	n->name   = intern(name);
+	release(old);
+	n->prev   = 0;
+	n->next   = parent->children;
+	if (n->next)
+		n->next->prev = n;
+	parent->children = n;
+	children[child_key(parent, n->name)] = n;
+}
+
+void treewatcher::scan(struct node *n, unsigned int threads, std::vector<std::pair<std::string, uint32_t> > *found)
+{
+	struct job
+	{
+		struct node *n;   ///< node of the directory
+		std::string  abs; ///< path of the directory
+		std::string  rel; ///< path of the directory relative to the root with trailing slash (empty for the root)
+	};
+
+	std::vector<job> jobs;
+	std::vector<std::thread> workers;
+	std::mutex mtx;
+	std::condition_variable cv;
+	unsigned int busy = 0;
+	std::string rel = path(n);
+
+	jobs.push_back(job{n, root + (rel.empty() ? "" : "/" + rel), rel.empty() ? rel : rel + "/"});
+
+	// directories are listed and watched without the lock, only the tree is updated under it
+	auto work = [&]() {
+		std::vector<std::pair<std::string, int> > subdirs;
+		std::vector<std::pair<std::string, uint32_t> > entries;
+		std::unique_lock<std::mutex> lock(mtx);
+		struct dirent *de;
+		struct stat st;
+		struct node *c;
+		bool isdir;
+		DIR *dir;
+		int wd;
+
+		for (;;) {
+			while (jobs.empty() && busy)
+				cv.wait(lock);
+			if (jobs.empty())
+				break;
+
+			job j = std::move(jobs.back());
+			jobs.pop_back();
+			busy++;
+			lock.unlock();
+
+			subdirs.clear();
+			entries.clear();
+
+			dir = opendir(j.abs.c_str());
+			if (!dir)
+				ELOG_ERRNO(ELOG_DEBUG, DBG_PREFIX"opening directory %s failed", j.abs.c_str());
+
+			while (dir && (de = readdir(dir))) {
+				if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+					continue;
+
+				isdir = de->d_type == DT_DIR || (de->d_type == DT_UNKNOWN &&
+				        !fstatat(dirfd(dir), de->d_name, &st, AT_SYMLINK_NOFOLLOW) && S_ISDIR(st.st_mode));
+
+				if (found)
+					entries.push_back(std::make_pair(j.rel + de->d_name, isdir ? IN_ISDIR : 0));
+				if (!isdir)
+					continue;
+
+				wd = inotify_add_watch(fd, (j.abs + "/" + de->d_name).c_str(), mask | TREEWATCHER_WATCH_MASK);
+				if (wd == -1)
+					ELOG_ERRNO(ELOG_DEBUG, DBG_PREFIX"adding watch for %s/%s failed", j.abs.c_str(), de->d_name);
+				else
+					subdirs.push_back(std::make_pair(std::string(de->d_name), wd));
+			}
+
+			if (dir)
+				closedir(dir);
+
+			lock.lock();
+			for (auto &sub : subdirs)
+				if ((c = add_node(sub.second, j.n, sub.first)))
+					jobs.push_back(job{c, j.abs + "/" + sub.first, j.rel + sub.first + "/"});
+			if (found)
+				found->insert(found->end(), entries.begin(), entries.end());
+			busy--;
+			cv.notify_all();
+		}
+	};
+
+	for (unsigned int i = 1; i < threads; ++i)
+		workers.emplace_back(work);
+	work();
+	for (auto &w : workers)
+		w.join();
+}
+
+int treewatcher::flush_move()
+{
+	moving = false;
+
+	if (move.dir)
+		del_node(move.dir, true);
+
+	return (mask & IN_MOVE) ? moved(move.mask, move.from, std::string()) : 0;
+}
+
+int treewatcher::handler(struct epoller *epoller, struct epoll_event *revent)
+{
+	int ret;
+	struct epoller_event **pthis = epoller_event::pthis;
+
+	ret = inotepoller::handler(epoller, revent);
+	if (ret || !*pthis || fd == -1)
+		return ret;
+
+	return check_move();
+}
+
+int treewatcher::flush(struct epoller *epoller, int *timeout)
+{
+	int ret;
+	struct epoller_event **pthis = epoller_event::pthis;
+
+	ret = inotepoller::flush(epoller, timeout);
+	if (ret || !*pthis || fd == -1)
+		return ret;
+
+	return check_move();
+}
+
+int treewatcher::check_move()
+{
+	int avail = 0;
+
+	if (!moving)
+		return 0;
+
+	// IN_MOVED_TO pair follows immediately if any, so nothing queued means the entry was moved out of the tree
+	if (ioctl(fd, FIONREAD, &avail) == -1 || !avail)
+		return flush_move();
+
+	return 0;
+}
+
+int treewatcher::inothandler(struct inotify_event *event)
+{
+	std::unordered_map<int, struct node*>::iterator it;
+	std::unordered_map<child_key, struct node*, child_hash>::iterator ct;
+	std::unordered_map<std::string, unsigned int>::iterator nt;
+	std::vector<std::pair<std::string, uint32_t> > found;
+	struct epoller_event **pthis = epoller_event::pthis;
+	struct node *n, *c;
+	std::string p, from;
+	uint32_t isdir = event->mask & IN_ISDIR;
+	bool paired = false;
+	int ret, wd;
+
+	// unpaired IN_MOVED_FROM event means the entry was moved out of the tree
+	if (moving && !((event->mask & IN_MOVED_TO) && event->cookie == move.cookie)) {
+		ret = flush_move();
+		if (ret || !*pthis || fd == -1)
+			return ret;
+	}
+
+	it = nodes.find(event->wd);
+	if (it == nodes.end())
+		return 0; // watch removed meanwhile
+	n = it->second;
+
+	if (event->mask & IN_IGNORED) {
+		// directory deleted (its subdirectories have been ignored before)
+		del_node(n, false);
+		return 0;
+	}
+
+	if (!event->len)
+		return 0; // events of directory itself are reported by its parent
+
+	p = path(n, event->name);
+
+	if (event->mask & IN_MOVED_FROM) {
+		moving      = true;
+		move.cookie = event->cookie;
+		move.mask   = IN_MOVE | isdir;
+		move.from   = p;
+		move.dir    = 0;
+
+		if (isdir && (nt = names.find(event->name)) != names.end() &&
+		    (ct = children.find(child_key(n, &nt->first))) != children.end())
+			move.dir = ct->second;
+
+		return 0;
+	}
+
+	if ((event->mask & IN_MOVED_TO) && moving) {
+		// moved within the tree, watched directory keeps its watch descriptor
+		moving = false;
+		paired = true;
+		from   = move.from;
+
+		if (move.dir)
+			move_node(move.dir, n, event->name);
+	}
+
+	// watch new (or moved in) directory and its subtree
+	if (isdir && (event->mask & (IN_CREATE | IN_MOVED_TO)) && !(paired && move.dir)) {
+		wd = inotify_add_watch(fd, (root + "/" + p).c_str(), mask | TREEWATCHER_WATCH_MASK);
+		if (wd == -1)
+			ELOG_ERRNO(ELOG_DEBUG, DBG_PREFIX"adding watch for %s failed", p.c_str());
+		else if ((c = add_node(wd, n, event->name)))
+			scan(c, 1, (event->mask & IN_CREATE) ? &found : 0);
+	}
+
+	if (event->mask & IN_MOVED_TO)
+		return (mask & IN_MOVE) ? moved(IN_MOVE | isdir, from, p) : 0;
+
+	if (!(event->mask & mask))
+		return 0;
+
+	ret = changed(event->mask, p);
+
+	// entries created in the new directory before its watch was added
+	for (size_t i = 0; i < found.size() && !ret && *pthis && fd != -1; ++i)
+		ret = changed(IN_CREATE | found[i].second, found[i].first);
+
+	return ret;
+}
+
+int treewatcher::overflow(struct inotify_event *event)
+{
+	return lost();
+}
+
+int treewatcher::changed(uint32_t mask, const std::string &path)
+{
+	if (rcvr)
+		return dynamic_cast<receiver *>(rcvr)->changed(*this, mask, path);
+	else if (_changed)
+		return _changed(*this, mask, path);
+	else {
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: changed");
+		return -1;
+	}
+}
+
+int treewatcher::moved(uint32_t mask, const std::string &from, const std::string &to)
+{
+	if (rcvr)
+		return dynamic_cast<receiver *>(rcvr)->moved(*this, mask, from, to);
+	else if (_moved)
+		return _moved(*this, mask, from, to);
+	else {
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: moved");
+		return -1;
+	}
+}
+
+int treewatcher::lost()
+{
+	if (rcvr)
+		return dynamic_cast<receiver *>(rcvr)->lost(*this);
+	else if (_lost)
+		return _lost(*this);
+	else {
+		ELOG(ELOG_WARNING, DBG_PREFIX"unhandled event: lost");
+		return -1;
+	}
+}
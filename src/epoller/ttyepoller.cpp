@@ -1,8 +1,8 @@
 #include <epoller/ttyepoller.h>
+#include <epoller/log.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <cstdio>
-#include <iostream>
 #include <cstring>
 
 #define DBG_PREFIX "ttyepoller: "
@@ -13,7 +13,7 @@ bool ttyepoller::init(int fd, size_t rxsize, size_t txsize, bool rxen, bool txen
 		return true;
 
 	if (!isatty(fd)) {
-		perror(DBG_PREFIX"checking tty failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"checking tty failed");
 		return false;
 	}
 
@@ -30,7 +30,7 @@ bool ttyepoller::open(const std::string &pathname, int flags, size_t rxsize, siz
 
 	int fd = ::open(pathname.c_str(), flags);
 	if (fd == -1) {
-		perror(DBG_PREFIX"opening file failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"opening file failed");
 		return false;
 	}
 
@@ -74,7 +74,7 @@ bool ttyepoller::raw_serial(speed_t speed, int csize, int parity, bool stopb, bo
 
 	// set attributes to the tty
 	if (tcsetattr(fd, TCSANOW, &tio)) {
-		perror(DBG_PREFIX"setting tty attributes failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"setting tty attributes failed");
 		return false;
 	}
 
@@ -82,12 +82,12 @@ bool ttyepoller::raw_serial(speed_t speed, int csize, int parity, bool stopb, bo
 
 	struct termios tio2 = {};
 	if (tcgetattr(fd, &tio2)) {
-		perror(DBG_PREFIX"getting tty attributes failed");
+		ELOG_ERRNO(ELOG_ERROR, DBG_PREFIX"getting tty attributes failed");
 		return false;
 	}
 
 	if (memcmp(&tio, &tio2, sizeof(struct termios))) {
-		std::cerr << DBG_PREFIX"tty attributes check failed" << std::endl;
+		ELOG(ELOG_ERROR, DBG_PREFIX"tty attributes check failed");
 		return false;
 	}
 
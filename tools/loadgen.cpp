@@ -0,0 +1,450 @@
+// epoller-loadgen - TCP load generator built on tcpcepoller.
+//
+// Opens many concurrent connections against a server and sends requests either in closed loop (every connection
+// sends next request after response to the previous one is received) or in open loop (requests are sent at fixed
+// total rate regardless of responses). In open loop the latency is measured from the time the request should have
+// been sent, so it is not affected by coordinated omission.
+
+#include <epoller/epoller.h>
+#include <epoller/framer.h>
+#include <epoller/tcpcepoller.h>
+#include <epoller/timepoller.h>
+#include <sys/socket.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <time.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define DBG_PREFIX "epoller-loadgen: "
+
+/// @brief Number of sub-buckets per power of two in histogram (gives relative precision better than 1%).
+#define HISTOGRAM_SUB_BUCKETS 128
+
+/// @brief Number of powers of two in histogram (values up to 2^40 ns, i.e. about 18 minutes).
+#define HISTOGRAM_BUCKETS 40
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/// @brief Log-linear latency histogram (HdrHistogram-like).
+struct histogram
+{
+	std::vector<uint64_t> counts; ///< counts of buckets
+	uint64_t              total;  ///< number of recorded values
+	uint64_t              min;    ///< minimal recorded value
+	uint64_t              max;    ///< maximal recorded value
+	double                sum;    ///< sum of recorded values
+	double                sumsq;  ///< sum of squares of recorded values
+
+	histogram() : counts(HISTOGRAM_BUCKETS * HISTOGRAM_SUB_BUCKETS / 2 + HISTOGRAM_SUB_BUCKETS / 2), total(0),
+	              min(UINT64_MAX), max(0), sum(0), sumsq(0) {}
+
+	/// @brief Gets index of bucket for given value.
+	///
+	/// Values below #HISTOGRAM_SUB_BUCKETS have their own buckets, each further power of two is split
+	/// into #HISTOGRAM_SUB_BUCKETS / 2 buckets.
+	static size_t index(uint64_t val)
+	{
+		unsigned int exp;
+
+		if (val < HISTOGRAM_SUB_BUCKETS)
+			return val;
+		exp = 63 - __builtin_clzll(val) - (__builtin_ctz(HISTOGRAM_SUB_BUCKETS) - 1);
+		if (exp >= HISTOGRAM_BUCKETS)
+			return HISTOGRAM_BUCKETS * HISTOGRAM_SUB_BUCKETS / 2 + HISTOGRAM_SUB_BUCKETS / 2 - 1;
+		return exp * HISTOGRAM_SUB_BUCKETS / 2 + (val >> exp);
+	}
+
+	/// @brief Gets the highest value, which falls into bucket of given index.
+	static uint64_t value(size_t ix)
+	{
+		size_t exp, sub;
+
+		if (ix < HISTOGRAM_SUB_BUCKETS)
+			return ix;
+		exp = ix / (HISTOGRAM_SUB_BUCKETS / 2) - 1;
+		sub = ix % (HISTOGRAM_SUB_BUCKETS / 2) + HISTOGRAM_SUB_BUCKETS / 2;
+		return ((uint64_t) (sub + 1) << exp) - 1;
+	}
+
+	/// @brief Records value.
+	void record(uint64_t val)
+	{
+		counts[index(val)]++;
+		total++;
+		sum   += val;
+		sumsq += (double) val * val;
+		if (val < min)
+			min = val;
+		if (val > max)
+			max = val;
+	}
+
+	/// @brief Gets value at given percentile.
+	uint64_t percentile(double p) const
+	{
+		uint64_t cnt = 0, limit = (uint64_t) ceil(p / 100.0 * total);
+
+		if (!limit)
+			limit = 1;
+		for (size_t i = 0; i < counts.size(); ++i)
+			if ((cnt += counts[i]) >= limit)
+				return std::min(value(i), max);
+		return max;
+	}
+
+	/// @brief Prints percentile distribution (in microseconds) in HdrHistogram format.
+	void print(FILE *out) const
+	{
+		static const double percentiles[] = {0, 10, 20, 30, 40, 50, 55, 60, 65, 70, 75, 77.5, 80, 82.5, 85, 87.5,
+		                                     90, 91.25, 92.5, 93.75, 95, 96.25, 97.5, 98.4375, 99, 99.21875,
+		                                     99.5, 99.609375, 99.75, 99.8046875, 99.9, 99.90234375, 99.95,
+		                                     99.990234375, 99.999, 100};
+		double mean = total ? sum / total : 0, var = total ? sumsq / total - mean * mean : 0;
+		uint64_t cnt;
+
+		fprintf(out, "%12s %14s %10s %14s\n\n", "Value(us)", "Percentile", "TotalCount", "1/(1-Percentile)");
+		for (size_t i = 0; i < sizeof percentiles / sizeof percentiles[0]; ++i) {
+			double p = percentiles[i];
+			cnt = (uint64_t) ceil(p / 100.0 * total);
+			if (p < 100)
+				fprintf(out, "%12.3f %14.12f %10llu %14.2f\n", percentile(p) / 1000.0, p / 100.0,
+				        (unsigned long long) cnt, 1.0 / (1.0 - p / 100.0));
+			else
+				fprintf(out, "%12.3f %14.12f %10llu\n", max / 1000.0, 1.0, (unsigned long long) total);
+		}
+		fprintf(out, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", mean / 1000.0, sqrt(var > 0 ? var : 0) / 1000.0);
+		fprintf(out, "#[Max     = %12.3f, Total count    = %12llu]\n", max / 1000.0, (unsigned long long) total);
+	}
+};
+
+/// @brief Load generator configuration.
+struct config
+{
+	std::string  host;        ///< server address
+	int          port;        ///< server port
+	unsigned int conns;       ///< number of connections
+	double       duration;    ///< test duration in seconds
+	double       warmup;      ///< warmup duration in seconds (latencies are not recorded)
+	double       rate;        ///< total request rate (requests per second), zero for closed loop
+	size_t       reqsize;     ///< request payload size
+	std::string  framing;     ///< framing of requests and responses: fixed, line, len4
+	size_t       respsize;    ///< response size (fixed framing)
+
+	config() : host("127.0.0.1"), port(0), conns(1), duration(10), warmup(0), rate(0), reqsize(64),
+	           framing("fixed"), respsize(0) {}
+};
+
+struct loadgen;
+
+/// @brief One connection of the load generator.
+struct connection : tcpcepoller::receiver
+{
+	struct loadgen       *lg;        ///< load generator
+	tcpcepoller           sock;      ///< socket
+	struct framer         frmr;      ///< response framer
+	std::deque<uint64_t>  pending;   ///< (intended) send times of requests waiting for response
+	bool                  connected; ///< connection is established
+
+	connection(struct loadgen *lg, struct epoller *epoller) : lg(lg), sock(epoller), frmr(), pending(), connected(false) {}
+
+	bool start();
+	void send(uint64_t when);
+
+	virtual int con(tcpcepoller &sender, bool connected);
+	virtual int rx(fdepoller &sender, int len);
+	virtual int frame(fdepoller &sender, const uint8_t *data, size_t len);
+	virtual int tx(fdepoller &sender, int len);
+	virtual int hup(fdepoller &sender);
+	virtual int err(fdepoller &sender);
+};
+
+/// @brief Load generator.
+struct loadgen : timepoller::receiver
+{
+	struct config             cfg;       ///< configuration
+	struct epoller            ep;        ///< epoller
+	timepoller                ticker;    ///< open loop request timer
+	timepoller                stopper;   ///< end of test timer
+	std::vector<connection*>  conns;     ///< connections
+	std::string               request;   ///< request (including framing)
+	histogram                 hist;      ///< latency histogram
+	uint64_t                  start;     ///< test start time
+	uint64_t                  record;    ///< time since latencies are recorded
+	uint64_t                  next;      ///< intended time of next request (open loop)
+	uint64_t                  interval;  ///< interval between requests (open loop)
+	size_t                    rr;        ///< round-robin connection index (open loop)
+	unsigned long             sent;      ///< number of sent requests
+	unsigned long             received;  ///< number of received responses
+	unsigned long             errors;    ///< number of connection errors
+	unsigned long             skipped;   ///< number of requests not sent as no connection was established
+
+	loadgen() : cfg(), ep(), ticker(&ep), stopper(&ep), conns(), request(), hist(), start(0), record(0), next(0),
+	            interval(0), rr(0), sent(0), received(0), errors(0), skipped(0) {}
+
+	~loadgen()
+	{
+		for (size_t i = 0; i < conns.size(); ++i)
+			delete conns[i];
+	}
+
+	bool init();
+	int run();
+	void report();
+
+	virtual int timerhandler(timepoller &sender, uint64_t exp);
+};
+
+bool connection::start()
+{
+	if (!sock.socket(AF_INET, 65536, 65536))
+		return false;
+	sock.rcvr = this;
+	sock.frmr = &frmr;
+	return sock.connect(lg->cfg.host, lg->cfg.port);
+}
+
+void connection::send(uint64_t when)
+{
+	if (sock.write_stream(lg->request.data(), lg->request.size()) != (ssize_t) lg->request.size()) {
+		std::cerr << DBG_PREFIX"request does not fit into tx buffer" << std::endl;
+		return;
+	}
+	pending.push_back(when);
+	lg->sent++;
+}
+
+int connection::con(tcpcepoller &sender, bool connected)
+{
+	if (!connected) {
+		perror(DBG_PREFIX"connecting failed");
+		lg->errors++;
+		sender.close();
+		return 0;
+	}
+
+	this->connected = true;
+	sender.enable_rx();
+
+	// closed loop: send the first request
+	if (!lg->cfg.rate)
+		send(now_ns());
+
+	return 0;
+}
+
+int connection::rx(fdepoller &sender, int len)
+{
+	// only errors and end of stream get here, responses are delivered as frames
+	if (len == 0)
+		std::cerr << DBG_PREFIX"connection closed by server" << std::endl;
+	lg->errors++;
+	connected = false;
+	sock.close();
+	return 0;
+}
+
+int connection::frame(fdepoller &sender, const uint8_t *data, size_t len)
+{
+	uint64_t now = now_ns();
+
+	if (pending.empty()) {
+		std::cerr << DBG_PREFIX"unexpected response" << std::endl;
+		return -1;
+	}
+
+	if (pending.front() >= lg->record)
+		lg->hist.record(now - pending.front());
+	pending.pop_front();
+	lg->received++;
+
+	// closed loop: send next request
+	if (!lg->cfg.rate)
+		send(now);
+
+	return 0;
+}
+
+int connection::tx(fdepoller &sender, int len)
+{
+	return len < 0 ? rx(sender, -1) : 0;
+}
+
+int connection::hup(fdepoller &sender)
+{
+	return rx(sender, -1);
+}
+
+int connection::err(fdepoller &sender)
+{
+	return rx(sender, -1);
+}
+
+bool loadgen::init()
+{
+	uint32_t len = cfg.reqsize;
+
+	// build request and set up response framing
+	if (cfg.framing == "fixed") {
+		request.assign(cfg.reqsize, 'x');
+	} else if (cfg.framing == "line") {
+		request.assign(cfg.reqsize ? cfg.reqsize - 1 : 0, 'x');
+		request += '\n';
+	} else if (cfg.framing == "len4") {
+		request += (char) (len >> 24);
+		request += (char) (len >> 16);
+		request += (char) (len >> 8);
+		request += (char) len;
+		request.append(cfg.reqsize, 'x');
+	} else {
+		std::cerr << DBG_PREFIX"unknown framing " << cfg.framing << std::endl;
+		return false;
+	}
+
+	if (!ep.init() || !ticker.init() || !stopper.init())
+		return false;
+	ticker.rcvr  = this;
+	stopper.rcvr = this;
+
+	for (unsigned int i = 0; i < cfg.conns; ++i) {
+		connection *c = new connection(this, &ep);
+		conns.push_back(c);
+
+		if (cfg.framing == "fixed")
+			c->frmr.init_fixed(cfg.respsize ? cfg.respsize : request.size());
+		else if (cfg.framing == "line")
+			c->frmr.init_delimiter("\n");
+		else
+			c->frmr.init_length(4);
+
+		if (!c->start()) {
+			std::cerr << DBG_PREFIX"starting connection failed" << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int loadgen::timerhandler(timepoller &sender, uint64_t exp)
+{
+	uint64_t now = now_ns();
+	struct timespec ts;
+
+	if (&sender == &stopper)
+		return 1;
+
+	// send all requests which are due, each to next established connection
+	while (next <= now) {
+		size_t i;
+		for (i = 0; i < conns.size() && !conns[rr]->connected; ++i)
+			rr = (rr + 1) % conns.size();
+		if (i == conns.size())
+			skipped++;
+		else
+			conns[rr]->send(next);
+		rr = (rr + 1) % conns.size();
+		next += interval;
+	}
+
+	// wait for next request
+	ts.tv_sec  = next / 1000000000;
+	ts.tv_nsec = next % 1000000000;
+	return ticker.arm_oneshot(&ts, TFD_TIMER_ABSTIME) ? 0 : -1;
+}
+
+int loadgen::run()
+{
+	start  = now_ns();
+	record = start + (uint64_t) (cfg.warmup * 1e9);
+
+	if (!stopper.arm_oneshot_usec((uint64_t) ((cfg.warmup + cfg.duration) * 1e6)))
+		return -1;
+
+	if (cfg.rate > 0) {
+		interval = (uint64_t) (1e9 / cfg.rate);
+		if (!interval)
+			interval = 1;
+		next = start;
+		if (!ticker.arm_oneshot_usec(1))
+			return -1;
+	}
+
+	return ep.loop() ? 0 : -1;
+}
+
+void loadgen::report()
+{
+	double elapsed = (now_ns() - record) / 1e9;
+
+	printf("%s loop, %u connections, %.1f s (+%.1f s warmup)\n", cfg.rate > 0 ? "open" : "closed",
+	       cfg.conns, cfg.duration, cfg.warmup);
+	printf("requests sent %lu, responses received %lu, errors %lu, skipped %lu\n", sent, received, errors, skipped);
+	printf("throughput %.1f responses/s (recorded)\n", hist.total / elapsed);
+	printf("latency (us): p50 %.3f, p90 %.3f, p99 %.3f, p99.9 %.3f, p99.99 %.3f, max %.3f\n\n",
+	       hist.percentile(50) / 1000.0, hist.percentile(90) / 1000.0, hist.percentile(99) / 1000.0,
+	       hist.percentile(99.9) / 1000.0, hist.percentile(99.99) / 1000.0, hist.max / 1000.0);
+	hist.print(stdout);
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [options] -p port\n"
+	       "  -H host        server IPv4 address (default 127.0.0.1)\n"
+	       "  -p port        server port\n"
+	       "  -c conns       number of connections (default 1)\n"
+	       "  -d seconds     test duration (default 10)\n"
+	       "  -w seconds     warmup duration, latencies are not recorded (default 0)\n"
+	       "  -r rate        total request rate per second for open loop, closed loop if not set\n"
+	       "  -s size        request payload size in bytes (default 64)\n"
+	       "  -f framing     fixed, line (terminated by LF) or len4 (4 bytes big endian length prefix)\n"
+	       "  -R size        response size for fixed framing (default equals to request size)\n"
+	       "  -h             this help\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	loadgen lg;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "H:p:c:d:w:r:s:f:R:h")) != -1) {
+		switch (opt) {
+		case 'H': lg.cfg.host     = optarg;               break;
+		case 'p': lg.cfg.port     = atoi(optarg);         break;
+		case 'c': lg.cfg.conns    = atoi(optarg);         break;
+		case 'd': lg.cfg.duration = atof(optarg);         break;
+		case 'w': lg.cfg.warmup   = atof(optarg);         break;
+		case 'r': lg.cfg.rate     = atof(optarg);         break;
+		case 's': lg.cfg.reqsize  = strtoul(optarg, 0, 0); break;
+		case 'f': lg.cfg.framing  = optarg;               break;
+		case 'R': lg.cfg.respsize = strtoul(optarg, 0, 0); break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (!lg.cfg.port || !lg.cfg.conns) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (!lg.init() || lg.run() < 0) {
+		std::cerr << DBG_PREFIX"load generation failed" << std::endl;
+		return 1;
+	}
+
+	lg.report();
+	return 0;
+}